@@ -0,0 +1,113 @@
+#pragma once
+
+#include "bounding_box.h"
+#include "surfaces.h"
+
+// Largest number of lines drawn along a curve of an adaptive surface, and of curves drawn in each direction
+constexpr size_t max_surface_steps = 64;
+constexpr size_t max_surface_curves = 21;
+
+static_assert(max_surface_steps <= precomputed_power_steps && max_surface_curves <= precomputed_power_steps,
+              "Tables of powers of adaptive surfaces must be built up front, so that looking them up does not lock");
+
+// Distance, in pixels, between the curves of an adaptive surface, unless limited by max_surface_curves
+constexpr double surface_curve_spacing = 12;
+
+// Length of the vector with coordinates x, y and z
+inline double length_of(double x, double y, double z)
+{
+    return sqrt(x * x + y * y + z * z);
+}
+
+// Number of lines needed to draw the cubic curve with coefficients x, y and z, for t^3 to 1, within tolerance.
+// Lines over steps of length h stay within h^2 / 8 of the curve times the largest second derivative,
+// which is 2b + 6at, and so is largest at one of the edges.
+inline size_t curve_steps(const TVector &x, const TVector &y, const TVector &z, double tolerance)
+{
+    const double second = max(
+        length_of(2 * x[1], 2 * y[1], 2 * z[1]),
+        length_of(6 * x[0] + 2 * x[1], 6 * y[0] + 2 * y[1], 6 * z[0] + 2 * z[1]));
+
+    return min(max_surface_steps, max(size_t(1), size_t(ceil(sqrt(second / (8 * tolerance))))));
+}
+
+// Bound, in one coordinate, of the second derivative in t of the surface with coefficient matrix c, for s and t in [0, 1]:
+// each coefficient is weighted by a power of s of at most 1, and the derivative is largest at t = 0 or t = 1.
+inline double second_derivative_bound(const TMatrix &c)
+{
+    double at_start = 0, at_end = 0;
+
+    for (size_t i = TVector::first_index; i <= TVector::last_index; i++)
+    {
+        const TVector row = c.row(i);
+        at_start += fabs(2 * row[1]);
+        at_end += fabs(6 * row[0] + 2 * row[1]);
+    }
+
+    return max(at_start, at_end);
+}
+
+// Number of lines needed to draw every curve in t of the surface with coefficient matrices cx, cy and cz within tolerance
+inline size_t surface_steps(const TMatrix &cx, const TMatrix &cy, const TMatrix &cz, double tolerance)
+{
+    const double second = length_of(second_derivative_bound(cx), second_derivative_bound(cy), second_derivative_bound(cz));
+
+    return min(max_surface_steps, max(size_t(1), size_t(ceil(sqrt(second / (8 * tolerance))))));
+}
+
+// Generate the vertices to represent a surface patch within tolerance of it, as curves in s and in t spaced by about
+// spacing, all in world units, each curve drawn as a chain of lines ending in ends.
+// The curves on the sides of the patch take their number of lines from the side alone, so that patches sharing a side
+// draw it with the same vertices, leaving no cracks between them.
+template<class Coord>
+inline void generate_adaptive_surface_vertices(
+    vector<Coord> &vertices,
+    vector<size_t> &ends,
+    const TMatrix &curve_matrix,
+    const vector<Coord> &controls,
+    double tolerance,
+    double spacing)
+{
+    static_assert(is_convertible<TVector, Coord>::value, "Coord must have constructor: Coord(const TVector &)");
+
+    assert(controls.size() == surface_geometry_matrix_size);
+
+    const TMatrix cx = surface_matrix(curve_matrix, controls, 0);
+    const TMatrix cy = surface_matrix(curve_matrix, controls, 1);
+    const TMatrix cz = surface_matrix(curve_matrix, controls, 2);
+
+    // Coefficients for curves in t, along which s is constant, then for curves in s
+    const TMatrix c[2][3] = { { cx, cy, cz }, { transposed(cx), transposed(cy), transposed(cz) } };
+
+    // Curves in each direction from the size of the patch, which lies in the box bounding its controls
+    BoundingBox box;
+    for (auto &control: controls) box.add(control);
+
+    const double size = distance(box.min(), box.max());
+    const size_t curves = min(max_surface_curves, max(size_t(2), size_t(ceil(size / spacing)) + 1));
+
+    const BasisTable &curve_table = power_table(curves - 1);
+
+    for (auto &m: c)
+    {
+        const size_t inner_steps = surface_steps(m[0], m[1], m[2], tolerance);
+
+        for (size_t k = 0; k < curves; k++)
+        {
+            const TVector &vs = curve_table[k];
+            const TVector x = vs * m[0], y = vs * m[1], z = vs * m[2];
+
+            const bool side = k == 0 || k == curves - 1;
+            const size_t steps = side ? curve_steps(x, y, z, tolerance) : inner_steps;
+            const BasisTable &table = power_table(steps);
+
+            for (size_t j = 0; j <= steps; j++)
+            {
+                const TVector &vt = table[j];
+                vertices.push_back(Coord(x * vt, y * vt, z * vt));
+            }
+
+            ends.push_back(vertices.size());
+        }
+    }
+}
@@ -0,0 +1,83 @@
+// Blending weights of cubic curves sampled at fixed steps, computed once for each basis matrix and number of steps
+
+#pragma once
+
+#include "transforms.h"
+
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+
+using namespace std;
+
+// Weights of the four geometry values of a cubic curve with a basis matrix at each step from t = 0 to t = 1,
+// so that the sample at a step is the dot product of its weights with a geometry vector.
+class BasisTable
+{
+public:
+
+    BasisTable(const TMatrix &basis, size_t steps)
+    {
+        for (size_t k = 0; k <= steps; k++)
+            _weights.push_back(vector_of_step(double(k) / double(steps)) * basis);
+    }
+
+    // Number of steps; there is one more sample, as both ends are included.
+    size_t steps() const
+    {
+        return _weights.size() - 1;
+    }
+
+    // Weights of the sample at step k
+    const TVector & operator [] (size_t k) const
+    {
+        return _weights[k];
+    }
+
+private:
+
+    vector<TVector> _weights;
+
+};
+
+// Table of basis sampled in steps, built at first use and kept until the program ends; may be called from any thread.
+// Tables are looked up by the values of basis, so that equal matrices share them.
+inline const BasisTable & basis_table(const TMatrix &basis, size_t steps)
+{
+    using Values = array<double, TMatrix::column_count * TMatrix::row_count>;
+
+    static mutex lock;
+    static map<pair<Values, size_t>, unique_ptr<BasisTable>> tables;
+
+    Values values;
+    for (size_t c = 0; c < TMatrix::column_count; c++)
+        for (size_t r = 0; r < TMatrix::row_count; r++)
+            values[c * TMatrix::row_count + r] = basis.column(c)[r];
+
+    lock_guard<mutex> guard(lock);
+
+    unique_ptr<BasisTable> &table = tables[make_pair(values, steps)];
+    if (table == nullptr) table.reset(new BasisTable(basis, steps));
+
+    return *table;
+}
+
+// Largest number of steps of the tables of powers built up front
+constexpr size_t precomputed_power_steps = 64;
+
+// Table of the powers of t, for curves whose geometry is already in coefficients, sampled in steps.
+// Tables of up to precomputed_power_steps steps are built together on first use, then read without locking.
+inline const BasisTable & power_table(size_t steps)
+{
+    static const vector<BasisTable> tables = []()
+    {
+        vector<BasisTable> tables;
+        for (size_t s = 1; s <= precomputed_power_steps; s++)
+            tables.emplace_back(TMatrix(), s);
+
+        return tables;
+    }();
+
+    return steps >= 1 && steps <= precomputed_power_steps ? tables[steps - 1] : basis_table(TMatrix(), steps);
+}
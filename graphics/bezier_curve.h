@@ -1,44 +1,76 @@
 #pragma once
 
-#include "transforms.h"
+#include "basis_table.h"
 
-// Vector used to calculate points in each step of a Bezier curve
-inline TVector bezier_step_vector(double step)
-{
-    return vector_of_step(step) * bezier;
-}
+// Number of lines drawn along a Bezier curve, unless set for the curve
+constexpr size_t bezier_steps = 40;
 
-// Vector in the Bezier curve at step for geometry vectors gx and gy.
-inline TVector bezier_vertex(const TVector &gx, const TVector &gy, double step)
-{
-    const TVector b = bezier_step_vector(step);
-
-    return TVector(
-        {
-            b * gx,
-            b * gy,
-            1,
-            1
-        }
-    );
-}
-
-// Generate the vertices to represent a Bezier curve.
+// Generate the vertices to represent a Bezier curve in steps, each a dot product of the weights of its step,
+// from the table of the Bezier basis, with the geometry.
 template<class Coord>
 inline list<shared_ptr<Coord>> bezier_curve_vertices(const Coord &edge1, const Coord &control1, const Coord &control2,
-                                         const Coord &edge2)
+                                         const Coord &edge2, size_t steps = bezier_steps)
 {
     static_assert(is_convertible<TVector, Coord>::value, "Coord must have constructor: Coord(const TVector &)");
 
     const TVector gx = vector_of<Coord>({ edge1, control1, control2, edge2 }, 0);
     const TVector gy = vector_of<Coord>({ edge1, control1, control2, edge2 }, 1);
 
+    const BasisTable &table = basis_table(bezier, steps);
+
     list<shared_ptr<Coord>> coords;
-    for (double step = 0; step < 1 || equals(step, 1); step += 0.025)
+    for (size_t k = 0; k <= steps; k++)
     {
-        coords.push_back(make_shared<Coord>(bezier_vertex(gx, gy, step)));
+        const TVector &b = table[k];
+        coords.push_back(make_shared<Coord>(TVector({ b * gx, b * gy, 1, 1 })));
     }
 
     return coords;
 }
 
+
+// Largest number of times an adaptive curve is split in halves
+constexpr int max_subdivision_depth = 16;
+
+// Distance from point p to the segment between a and b, in the plane.
+inline double segment_distance(const TVector &p, const TVector &a, const TVector &b)
+{
+    const double dx = b[0] - a[0], dy = b[1] - a[1];
+    const double length = dx * dx + dy * dy;
+    const double t = length > 0 ? max(0.0, min(1.0, ((p[0] - a[0]) * dx + (p[1] - a[1]) * dy) / length)) : 0;
+
+    return hypot(p[0] - a[0] - t * dx, p[1] - a[1] - t * dy);
+}
+
+// Add the vertices after p0 of the Bezier curve with controls p0, p1, p2 and p3 to coords, splitting it in halves
+// by de Casteljau's algorithm until the internal controls of each half are within tolerance of the line between its
+// edges; as the curve lies in the convex hull of its controls, so is every point of the curve.
+template<class Coord>
+inline void subdivide_bezier(vector<Coord> &coords, const TVector &p0, const TVector &p1, const TVector &p2,
+                             const TVector &p3, double tolerance, int depth = 0)
+{
+    static_assert(is_convertible<TVector, Coord>::value, "Coord must have constructor: Coord(const TVector &)");
+
+    if (depth >= max_subdivision_depth ||
+        max(segment_distance(p1, p0, p3), segment_distance(p2, p0, p3)) <= tolerance)
+    {
+        coords.push_back(Coord(p3));
+        return;
+    }
+
+    const TVector p01 = equidistant(p0, p1), p12 = equidistant(p1, p2), p23 = equidistant(p2, p3);
+    const TVector p012 = equidistant(p01, p12), p123 = equidistant(p12, p23);
+    const TVector middle = equidistant(p012, p123);
+
+    subdivide_bezier(coords, p0, p01, p012, middle, tolerance, depth + 1);
+    subdivide_bezier(coords, middle, p123, p23, p3, tolerance, depth + 1);
+}
+
+// Generate the vertices to represent a Bezier curve within tolerance of it.
+template<class Coord>
+inline void adaptive_bezier_curve_vertices(vector<Coord> &coords, const Coord &edge1, const Coord &control1,
+                                           const Coord &control2, const Coord &edge2, double tolerance)
+{
+    coords.push_back(edge1);
+    subdivide_bezier(coords, edge1, control1, control2, edge2, tolerance);
+}
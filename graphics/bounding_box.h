@@ -0,0 +1,81 @@
+#pragma once
+
+#include "transforms.h"
+
+// Axis-aligned box bounding a set of coords
+class BoundingBox
+{
+public:
+
+    constexpr static size_t corner_count = 8;
+
+    BoundingBox() {}
+
+    template<class Coord>
+    BoundingBox(const list<Coord *> &coords)
+    {
+        for (const Coord *coord: coords)
+            add(*coord);
+    }
+
+    // True if no coord was added to the box.
+    bool empty() const
+    {
+        return _empty;
+    }
+
+    // Enlarge the box in order to contain v.
+    void add(const TVector &v)
+    {
+        for (size_t i = 0; i < axis_count; i++)
+        {
+            if (_empty || v[i] < _min[i]) _min[i] = v[i];
+            if (_empty || v[i] > _max[i]) _max[i] = v[i];
+        }
+
+        _empty = false;
+    }
+
+    // Enlarge the box in order to contain other.
+    void add(const BoundingBox &other)
+    {
+        if (other.empty()) return;
+
+        add(other.min());
+        add(other.max());
+    }
+
+    // Corner with the smallest coordinates
+    TVector min() const
+    {
+        return TVector({ _min[0], _min[1], _min[2], 1 });
+    }
+
+    // Corner with the largest coordinates
+    TVector max() const
+    {
+        return TVector({ _max[0], _max[1], _max[2], 1 });
+    }
+
+    // Corner at index i, where bits 0, 1 and 2 select the largest x, y and z respectively.
+    TVector corner(size_t i) const
+    {
+        assert(i < corner_count);
+
+        return TVector({
+            (i & 1) ? _max[0] : _min[0],
+            (i & 2) ? _max[1] : _min[1],
+            (i & 4) ? _max[2] : _min[2],
+            1
+        });
+    }
+
+private:
+
+    constexpr static size_t axis_count = 3;
+
+    double _min[axis_count] = { 0, 0, 0 };
+    double _max[axis_count] = { 0, 0, 0 };
+    bool _empty = true;
+
+};
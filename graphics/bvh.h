@@ -0,0 +1,153 @@
+// Bounding volume hierarchy over items with bounding boxes
+
+#pragma once
+
+#include "bounding_box.h"
+#include "graphics.h"
+
+// Node of a bounding volume hierarchy, kept in a flattened array in depth-first order
+struct BVHNode
+{
+    BoundingBox box;
+
+    // Range of items under the node
+    size_t first, count;
+
+    // Index of the second child; the first child follows the node. Zero for leaves.
+    size_t second;
+
+    bool leaf() const { return second == 0; }
+};
+
+// Bounding volume hierarchy built by splitting items at the median of the widest axis
+class BVH
+{
+public:
+
+    constexpr static size_t leaf_size = 16;
+
+    BVH() {}
+
+    BVH(const vector<BoundingBox> &boxes)
+    {
+        _items.resize(boxes.size());
+        for (size_t i = 0; i < _items.size(); i++) _items[i] = i;
+
+        _nodes.reserve(2 * (boxes.size() / leaf_size + 1));
+
+        if (!boxes.empty()) build(boxes, 0, boxes.size());
+    }
+
+    // True if there are no items in the hierarchy.
+    bool empty() const
+    {
+        return _nodes.empty();
+    }
+
+    // Flattened nodes, starting with the root
+    const vector<BVHNode> & nodes() const
+    {
+        return _nodes;
+    }
+
+    // Recompute the boxes of all nodes from the new boxes of the items, keeping the hierarchy.
+    void refit(const vector<BoundingBox> &boxes)
+    {
+        assert(boxes.size() == _items.size());
+
+        // Children come after their parents, so the nodes are refit in reverse order.
+        for (size_t i = _nodes.size(); i-- > 0;)
+        {
+            BVHNode &node = _nodes[i];
+            node.box = BoundingBox();
+
+            if (node.leaf())
+            {
+                for (size_t j = node.first; j < node.first + node.count; j++)
+                    node.box.add(boxes[_items[j]]);
+            }
+            else
+            {
+                node.box.add(_nodes[i + 1].box);
+                node.box.add(_nodes[node.second].box);
+            }
+        }
+    }
+
+    // Visit the items whose nodes are not classified as invisible.
+    // Items under fully visible nodes are visited with visible set to FULL; otherwise, PARTIAL.
+    template<class Classify, class Visit>
+    void traverse(Classify classify, Visit visit) const
+    {
+        if (empty()) return;
+
+        vector<size_t> pending { 0 };
+
+        while (!pending.empty())
+        {
+            const BVHNode &node = _nodes[pending.back()];
+            const size_t index = pending.back();
+            pending.pop_back();
+
+            const Visibility visibility = classify(node.box);
+
+            if (visibility == Visibility::NONE) continue;
+
+            if (visibility == Visibility::FULL || node.leaf())
+            {
+                for (size_t j = node.first; j < node.first + node.count; j++)
+                    visit(_items[j], visibility);
+            }
+            else
+            {
+                pending.push_back(node.second);
+                pending.push_back(index + 1);
+            }
+        }
+    }
+
+private:
+
+    // Build the node over items from first to last (exclusive), returning its index.
+    size_t build(const vector<BoundingBox> &boxes, size_t first, size_t last)
+    {
+        const size_t index = _nodes.size();
+        _nodes.push_back({ BoundingBox(), first, last - first, 0 });
+
+        BoundingBox centers;
+        for (size_t j = first; j < last; j++)
+        {
+            _nodes[index].box.add(boxes[_items[j]]);
+            centers.add(center(boxes[_items[j]]));
+        }
+
+        if (last - first <= leaf_size) return index;
+
+        const TVector extent = centers.max() - centers.min();
+        const size_t axis = extent[0] >= extent[1] && extent[0] >= extent[2] ? 0 : (extent[1] >= extent[2] ? 1 : 2);
+        const size_t middle = first + (last - first) / 2;
+
+        nth_element(_items.begin() + first, _items.begin() + middle, _items.begin() + last,
+            [&boxes, axis](size_t a, size_t b)
+            {
+                return center(boxes[a])[axis] < center(boxes[b])[axis];
+            });
+
+        build(boxes, first, middle);
+        const size_t second = build(boxes, middle, last);
+
+        _nodes[index].second = second;
+
+        return index;
+    }
+
+    // Center of box
+    static TVector center(const BoundingBox &box)
+    {
+        return equidistant(box.min(), box.max());
+    }
+
+    vector<BVHNode> _nodes;
+    vector<size_t> _items;
+
+};
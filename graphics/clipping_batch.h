@@ -0,0 +1,139 @@
+// Clipping of batches of segments in homogeneous clip space, several segments per SIMD instruction
+
+#pragma once
+
+#include "clipping_homogeneous.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+// Segments in clip space, kept as one contiguous array per coordinate of their ends
+class SegmentBatch
+{
+public:
+
+    // Number of segments clipped by each instruction
+    constexpr static size_t lanes = 4;
+
+    // Number of segments
+    size_t size() const
+    {
+        return _ax.size();
+    }
+
+    // Remove all segments.
+    void clear()
+    {
+        _ax.clear(); _ay.clear(); _aw.clear();
+        _bx.clear(); _by.clear(); _bw.clear();
+    }
+
+    // Add segment from a to b.
+    void add(const ClipPoint &a, const ClipPoint &b)
+    {
+        _ax.push_back(a.x); _ay.push_back(a.y); _aw.push_back(a.w);
+        _bx.push_back(b.x); _by.push_back(b.y); _bw.push_back(b.w);
+    }
+
+    // Start of segment i
+    ClipPoint a(size_t i) const
+    {
+        return { _ax[i], _ay[i], _aw[i] };
+    }
+
+    // End of segment i
+    ClipPoint b(size_t i) const
+    {
+        return { _bx[i], _by[i], _bw[i] };
+    }
+
+    // Clip all segments to the planes in mask, moved out by band, adding what is left of them to out, in order,
+    // and the index of the segment each comes from to sources unless nullptr.
+    // Distances to the planes, crossing parameters and clipped ends are computed for a group of segments at a time
+    // with branch-free vector operations; only the compaction of the surviving segments is done one by one.
+    void clip(unsigned mask, SegmentBatch &out, double band = 1, vector<size_t> *sources = nullptr) const
+    {
+        typedef double Double4 __attribute__((vector_size(lanes * sizeof(double))));
+        typedef long Mask4 __attribute__((vector_size(lanes * sizeof(long))));
+
+        static_assert(sizeof(Double4) == sizeof(Mask4), "Masks must be as wide as the values they select");
+
+        for (size_t first = 0; first < size(); first += lanes)
+        {
+            const size_t count = min(size_t(lanes), size() - first);
+
+            Double4 ax, ay, aw, bx, by, bw;
+            load(ax, _ax, first, count); load(ay, _ay, first, count); load(aw, _aw, first, count);
+            load(bx, _bx, first, count); load(by, _by, first, count); load(bw, _bw, first, count);
+
+            const Double4 as = aw * band, bs = bw * band;
+
+            Double4 enter = { 0, 0, 0, 0 }, leave = { 1, 1, 1, 1 };
+            Mask4 rejected = { 0, 0, 0, 0 };
+
+            for (unsigned plane = 1; plane <= CLIP_FAR; plane <<= 1)
+            {
+                if ((mask & plane) == 0) continue;
+
+                Double4 da, db;
+                switch (plane)
+                {
+                    case CLIP_LEFT: da = as + ax; db = bs + bx; break;
+                    case CLIP_RIGHT: da = as - ax; db = bs - bx; break;
+                    case CLIP_BOTTOM: da = as + ay; db = bs + by; break;
+                    case CLIP_TOP: da = as - ay; db = bs - by; break;
+                    case CLIP_NEAR: da = aw - near_w; db = bw - near_w; break;
+                    default: da = far_w - aw; db = far_w - bw; break;
+                }
+
+                const Mask4 a_out = da < 0, b_out = db < 0;
+                const Double4 t = da / (da - db);
+
+                rejected |= a_out & b_out;
+
+                // Entering where only a is out, leaving where only b is out; other lanes keep their parameters.
+                const Mask4 enters = a_out & ~b_out & (t > enter), leaves = b_out & ~a_out & (t < leave);
+                enter = (Double4) (((Mask4) t & enters) | ((Mask4) enter & ~enters));
+                leave = (Double4) (((Mask4) t & leaves) | ((Mask4) leave & ~leaves));
+            }
+
+            const Mask4 accepted = ~rejected & (enter <= leave);
+            const Mask4 moved_a = enter > 0, moved_b = leave < 1;
+
+            const Double4 dx = bx - ax, dy = by - ay, dw = bw - aw;
+            const Double4 cax = (Double4) (((Mask4) (ax + dx * enter) & moved_a) | ((Mask4) ax & ~moved_a));
+            const Double4 cay = (Double4) (((Mask4) (ay + dy * enter) & moved_a) | ((Mask4) ay & ~moved_a));
+            const Double4 caw = (Double4) (((Mask4) (aw + dw * enter) & moved_a) | ((Mask4) aw & ~moved_a));
+            const Double4 cbx = (Double4) (((Mask4) (ax + dx * leave) & moved_b) | ((Mask4) bx & ~moved_b));
+            const Double4 cby = (Double4) (((Mask4) (ay + dy * leave) & moved_b) | ((Mask4) by & ~moved_b));
+            const Double4 cbw = (Double4) (((Mask4) (aw + dw * leave) & moved_b) | ((Mask4) bw & ~moved_b));
+
+            for (size_t lane = 0; lane < count; lane++)
+            {
+                if (accepted[lane] == 0) continue;
+
+                out.add({ cax[lane], cay[lane], caw[lane] }, { cbx[lane], cby[lane], cbw[lane] });
+                if (sources != nullptr) sources->push_back(first + lane);
+            }
+        }
+    }
+
+private:
+
+    // Copy count values of coords from first into the lanes of packed, repeating the last one in the lanes left.
+    template<class Packed>
+    static void load(Packed &packed, const vector<double> &coords, size_t first, size_t count)
+    {
+        double values[lanes];
+
+        memcpy(values, &coords[first], count * sizeof(double));
+        for (size_t lane = count; lane < lanes; lane++) values[lane] = values[count - 1];
+
+        memcpy(&packed, values, sizeof(values));
+    }
+
+    vector<double> _ax, _ay, _aw, _bx, _by, _bw;
+
+};
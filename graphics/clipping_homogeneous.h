@@ -0,0 +1,91 @@
+// Line clipping in homogeneous clip space, before the perspective divide
+
+#pragma once
+
+#include <algorithm>
+
+using namespace std;
+
+// Point in clip space: Window coords multiplied by w, and w itself.
+// The window is the volume where -w <= x <= w, -w <= y <= w and near_w <= w <= far_w.
+struct ClipPoint
+{
+    double x, y, w;
+};
+
+// Smallest and largest w in the view volume, as multiples of the projection distance from the eye
+constexpr double near_w = 1e-3;
+constexpr double far_w = 1e6;
+
+// Planes bounding the view volume, one bit each in an outcode
+enum ClipPlane: unsigned
+{
+    CLIP_LEFT = 1 << 0,
+    CLIP_RIGHT = 1 << 1,
+    CLIP_BOTTOM = 1 << 2,
+    CLIP_TOP = 1 << 3,
+    CLIP_NEAR = 1 << 4,
+    CLIP_FAR = 1 << 5
+};
+
+constexpr unsigned CLIP_PLANE_COUNT = 6;
+constexpr unsigned CLIP_ALL = (1 << CLIP_PLANE_COUNT) - 1;
+
+// Signed distance of p to plane, positive inside the view volume.
+// The side planes are moved out to band times their distance from the center of the window.
+inline double clip_distance(const ClipPoint &p, unsigned plane, double band = 1)
+{
+    switch (plane)
+    {
+        case CLIP_LEFT: return p.w * band + p.x;
+        case CLIP_RIGHT: return p.w * band - p.x;
+        case CLIP_BOTTOM: return p.w * band + p.y;
+        case CLIP_TOP: return p.w * band - p.y;
+        case CLIP_NEAR: return p.w - near_w;
+        default: return far_w - p.w;
+    }
+}
+
+// Planes p lies outside of, with the side planes moved out to band times their distance from the center of the window
+inline unsigned outcode(const ClipPoint &p, double band = 1)
+{
+    const double side = p.w * band;
+
+    return (p.x < -side ? CLIP_LEFT : 0u) |
+           (p.x > side ? CLIP_RIGHT : 0u) |
+           (p.y < -side ? CLIP_BOTTOM : 0u) |
+           (p.y > side ? CLIP_TOP : 0u) |
+           (p.w < near_w ? CLIP_NEAR : 0u) |
+           (p.w > far_w ? CLIP_FAR : 0u);
+}
+
+// Clip segment between a and b, with outcodes code_a and code_b, to the planes in mask, moved out by band.
+// Both ends are moved onto the planes they cross; false if nothing of the segment is left.
+inline bool clip_segment(ClipPoint &a, ClipPoint &b, unsigned code_a, unsigned code_b, unsigned mask, double band = 1)
+{
+    const unsigned crossed = (code_a | code_b) & mask;
+
+    if (crossed == 0) return true;
+    if ((code_a & code_b & mask) != 0) return false;
+
+    double enter = 0, leave = 1;
+
+    for (unsigned plane = 1; plane <= CLIP_FAR; plane <<= 1)
+    {
+        if ((crossed & plane) == 0) continue;
+
+        const double da = clip_distance(a, plane, band), db = clip_distance(b, plane, band);
+        const double t = da / (da - db);
+
+        if (da < 0) enter = max(enter, t); else leave = min(leave, t);
+    }
+
+    if (enter > leave) return false;
+
+    const ClipPoint from = a, delta = { b.x - a.x, b.y - a.y, b.w - a.w };
+
+    if (enter > 0) a = { from.x + delta.x * enter, from.y + delta.y * enter, from.w + delta.w * enter };
+    if (leave < 1) b = { from.x + delta.x * leave, from.y + delta.y * leave, from.w + delta.w * leave };
+
+    return true;
+}
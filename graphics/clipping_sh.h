@@ -0,0 +1,58 @@
+// Polygon clipping based on the Sutherland-Hodgman algorithm
+
+#pragma once
+
+#include "transforms.h"
+
+#include <vector>
+
+using namespace std;
+
+// Keep the part of polygon in, with Window coord vertices, inside one side of the window, writing it to out.
+// The side is x = side if vertical, y = side otherwise, where side is -1 or +1; vertices on it are inside.
+template<class Coord>
+inline void clip_polygon_to_side(const vector<Coord> &in, vector<Coord> &out, bool vertical, double side)
+{
+    static_assert(is_base_of<XYCoord<Coord>, Coord>::value, "Coord must derive from XYCoord<Coord>");
+
+    out.clear();
+    if (in.empty()) return;
+
+    auto value = [vertical](const Coord &coord) { return vertical ? coord.x() : coord.y(); };
+    auto inside = [&value, side](const Coord &coord) { return side * value(coord) <= 1; };
+
+    const Coord *previous = &in.back();
+    bool previous_inside = inside(*previous);
+
+    for (auto &current: in)
+    {
+        const bool current_inside = inside(current);
+
+        if (current_inside != previous_inside)
+        {
+            // Crossing put exactly on the side, so that it is inside when clipping to the other sides
+            const double t = (side - value(*previous)) / (value(current) - value(*previous));
+            const double x = previous->x() + t * (current.x() - previous->x());
+            const double y = previous->y() + t * (current.y() - previous->y());
+
+            out.push_back(vertical ? Coord(side, y) : Coord(x, side));
+        }
+
+        if (current_inside) out.push_back(current);
+
+        previous = &current;
+        previous_inside = current_inside;
+    }
+}
+
+// Clip polygon with Window coord vertices using Sutherland-Hodgman, leaving the clipped polygon in vertices.
+// Concave polygons cut in several parts by the window come out as one polygon joined by lines along the window sides.
+// Scratch holds the polygon between passes; both are kept by the caller, so that clipping does not allocate.
+template<class Coord>
+inline void clip_polygon_using_sh(vector<Coord> &vertices, vector<Coord> &scratch)
+{
+    clip_polygon_to_side(vertices, scratch, true, -1);
+    clip_polygon_to_side(scratch, vertices, true, +1);
+    clip_polygon_to_side(vertices, scratch, false, -1);
+    clip_polygon_to_side(scratch, vertices, false, +1);
+}
@@ -0,0 +1,311 @@
+// Polygon clipping based on the Weiler-Atherton algorithm
+
+#pragma once
+
+#include "transforms.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+// True if Window coord is in the window or on its sides.
+template<class Coord>
+inline bool in_window_or_side(const Coord &coord)
+{
+    return coord.x() >= -1 && coord.x() <= 1 && coord.y() >= -1 && coord.y() <= 1;
+}
+
+// Determine the parameters where the segment between Window coord a and b enters and leaves the window.
+// False if the segment misses the window.
+template<class Coord>
+inline bool window_span(const Coord &a, const Coord &b, double &enter, double &leave)
+{
+    const double dx = b.x() - a.x(), dy = b.y() - a.y();
+    const double p[] = { -dx, dx, -dy, dy };
+    const double q[] = { a.x() + 1, 1 - a.x(), a.y() + 1, 1 - a.y() };
+
+    enter = 0;
+    leave = 1;
+
+    for (size_t i = 0; i < 4; i++)
+    {
+        if (p[i] == 0)
+        {
+            if (q[i] < 0) return false;
+        }
+        else if (p[i] < 0)
+        {
+            enter = max(enter, q[i] / p[i]);
+        }
+        else
+        {
+            leave = min(leave, q[i] / p[i]);
+        }
+    }
+
+    return enter <= leave;
+}
+
+// Position of Window coord on the window sides, from 0 to 4 counterclockwise, starting at the left-bottom corner.
+// Corner k is at position k: left-bottom, right-bottom, right-top and left-top.
+template<class Coord>
+inline double border_position(const Coord &coord)
+{
+    const double x = coord.x(), y = coord.y();
+    const double bottom = y + 1, right = 1 - x, top = 1 - y, left = x + 1;
+    const double nearest = min({ bottom, right, top, left });
+
+    if (nearest == bottom) return (x + 1) / 2;
+    if (nearest == right) return 1 + (y + 1) / 2;
+    if (nearest == top) return 2 + (1 - x) / 2;
+    return 3 + (1 - y) / 2;
+}
+
+// Distance along the window sides from border position from to position to,
+// going counterclockwise if ccw, clockwise otherwise
+inline double border_distance(double from, double to, bool ccw)
+{
+    return fmod(ccw ? to - from + 8 : from - to + 8, 4);
+}
+
+// Clipper of polygons to the window following Weiler-Atherton:
+// the sides of the polygon inside the window are joined along the window sides, in the direction the polygon turns,
+// so that concave polygons cut by the window come out as separate polygons.
+// Its scratch space is kept between polygons, so that clipping does not allocate.
+template<class Coord>
+class WeilerAthertonClipper
+{
+public:
+
+    // Clip polygon with Window coord vertices, replacing clipped with the vertices of all parts left, one after the other,
+    // and ends with the index in clipped one past the last vertex of each part.
+    void clip(const vector<Coord> &vertices, vector<Coord> &clipped, vector<size_t> &ends)
+    {
+        static_assert(is_base_of<XYCoord<Coord>, Coord>::value, "Coord must derive from XYCoord<Coord>");
+
+        clipped.clear();
+        ends.clear();
+
+        const size_t count = vertices.size();
+        if (count == 0) return;
+
+        // Start at a side entering the window, so that the sides inside it are found as whole runs.
+        size_t start = count;
+        for (size_t i = 0; i < count && start == count; i++)
+        {
+            const Coord &a = vertices[(i + count - 1) % count], &b = vertices[i];
+            double enter, leave;
+
+            if (!in_window_or_side(a) && window_span(a, b, enter, leave)) start = i;
+        }
+
+        if (start == count)
+        {
+            clip_uncrossed(vertices, clipped, ends);
+            return;
+        }
+
+        find_runs(vertices, start);
+
+        // Sides only touching the window leave no runs.
+        if (_runs.empty())
+        {
+            clip_around(vertices, clipped, ends);
+            return;
+        }
+
+        join_runs(turns_counterclockwise(vertices), clipped, ends);
+    }
+
+private:
+
+    // Sides of the polygon inside the window, from where they enter it to where they leave it
+    struct Run
+    {
+        size_t first, last;
+        double entry, exit;
+        bool joined;
+    };
+
+    // Clip polygon whose sides never enter the window: it is all inside, all outside, or around the window.
+    static void clip_uncrossed(const vector<Coord> &vertices, vector<Coord> &clipped, vector<size_t> &ends)
+    {
+        if (in_window_or_side(vertices.front()))
+        {
+            clipped = vertices;
+            ends.push_back(clipped.size());
+        }
+        else
+        {
+            clip_around(vertices, clipped, ends);
+        }
+    }
+
+    // Clip polygon whose sides at most touch the window: the window itself if the polygon goes around it.
+    static void clip_around(const vector<Coord> &vertices, vector<Coord> &clipped, vector<size_t> &ends)
+    {
+        if (!contains_center(vertices)) return;
+
+        const bool ccw = turns_counterclockwise(vertices);
+
+        clipped.push_back(Coord(-1, -1));
+        clipped.push_back(ccw ? Coord(1, -1) : Coord(-1, 1));
+        clipped.push_back(Coord(1, 1));
+        clipped.push_back(ccw ? Coord(-1, 1) : Coord(1, -1));
+        ends.push_back(clipped.size());
+    }
+
+    // Collect the runs of sides inside the window, starting with side start, which enters it.
+    // Runs only touching the window at a point, such as at a vertex on a window side, are left out.
+    void find_runs(const vector<Coord> &vertices, size_t start)
+    {
+        const size_t count = vertices.size();
+
+        _points.clear();
+        _runs.clear();
+
+        for (size_t k = 0; k < count; k++)
+        {
+            const size_t i = (start + k) % count;
+            const Coord &a = vertices[(i + count - 1) % count], &b = vertices[i];
+
+            double enter, leave;
+            if (!window_span(a, b, enter, leave)) continue;
+
+            if (!in_window_or_side(a))
+            {
+                const Coord entry = at(a, b, enter);
+                _runs.push_back({ _points.size(), _points.size(), border_position(entry), 0, false });
+                _points.push_back(entry);
+            }
+
+            if (leave < 1)
+            {
+                const Coord exit = at(a, b, leave);
+                _points.push_back(exit);
+                _runs.back().exit = border_position(exit);
+                _runs.back().last = _points.size();
+
+                if (touching(_runs.back()))
+                {
+                    _points.erase(_points.begin() + long(_runs.back().first), _points.end());
+                    _runs.pop_back();
+                }
+            }
+            else
+            {
+                _points.push_back(b);
+                _runs.back().last = _points.size();
+            }
+        }
+    }
+
+    // True if all points of run are the same, so that it only touches the window.
+    bool touching(const Run &run) const
+    {
+        for (size_t i = run.first + 1; i < run.last; i++)
+            if (_points[i] != _points[run.first]) return false;
+
+        return true;
+    }
+
+    // Join each run to the nearest entry of a run not joined yet, or of the first run of the part, ahead of where
+    // it leaves, adding the window corners in between.
+    void join_runs(bool ccw, vector<Coord> &clipped, vector<size_t> &ends)
+    {
+        for (size_t first_run = 0; first_run < _runs.size(); first_run++)
+        {
+            if (_runs[first_run].joined) continue;
+
+            size_t r = first_run;
+            do
+            {
+                Run &run = _runs[r];
+                run.joined = true;
+
+                clipped.insert(clipped.end(), _points.begin() + long(run.first), _points.begin() + long(run.last));
+
+                size_t next = first_run;
+                double nearest = 4;
+                for (size_t j = 0; j < _runs.size(); j++)
+                {
+                    if (_runs[j].joined && j != first_run) continue;
+
+                    const double distance = border_distance(run.exit, _runs[j].entry, ccw);
+                    if (distance < nearest)
+                    {
+                        nearest = distance;
+                        next = j;
+                    }
+                }
+
+                for (int step = 1; step <= 4; step++)
+                {
+                    const double corner = ccw ? fmod(floor(run.exit) + step, 4) : fmod(ceil(run.exit) - step + 8, 4);
+                    const double distance = border_distance(run.exit, corner, ccw);
+
+                    if (distance > 0 && distance < nearest) clipped.push_back(corner_at(int(corner)));
+                }
+
+                r = next;
+            }
+            while (r != first_run && !_runs[r].joined);
+
+            ends.push_back(clipped.size());
+        }
+    }
+
+    // Point at step t of the segment between a and b, kept on the window
+    static Coord at(const Coord &a, const Coord &b, double t)
+    {
+        const double x = a.x() + t * (b.x() - a.x()), y = a.y() + t * (b.y() - a.y());
+        return Coord(min(1.0, max(-1.0, x)), min(1.0, max(-1.0, y)));
+    }
+
+    // Window corner k, counterclockwise from left-bottom
+    static Coord corner_at(int k)
+    {
+        return Coord(k == 1 || k == 2 ? 1 : -1, k >= 2 ? 1 : -1);
+    }
+
+    // True if the polygon goes around counterclockwise, or has no area.
+    static bool turns_counterclockwise(const vector<Coord> &vertices)
+    {
+        double area = 0;
+
+        const Coord *previous = &vertices.back();
+        for (auto &current: vertices)
+        {
+            area += previous->x() * current.y() - current.x() * previous->y();
+            previous = &current;
+        }
+
+        return area >= 0;
+    }
+
+    // True if the center of the window is inside the polygon, by the even-odd rule.
+    static bool contains_center(const vector<Coord> &vertices)
+    {
+        bool inside = false;
+
+        const Coord *previous = &vertices.back();
+        for (auto &current: vertices)
+        {
+            if ((current.y() > 0) != (previous->y() > 0) &&
+                0 < previous->x() + (0 - previous->y()) * (current.x() - previous->x()) / (current.y() - previous->y()))
+            {
+                inside = !inside;
+            }
+
+            previous = &current;
+        }
+
+        return inside;
+    }
+
+    vector<Coord> _points;
+    vector<Run> _runs;
+
+};
@@ -0,0 +1,425 @@
+// Mesh simplification by quadric error metrics and levels of detail built from it
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Sum of squared distances to a set of planes, as a symmetric 4x4 matrix
+class Quadric
+{
+public:
+
+    Quadric()
+    {
+        fill(begin(_q), end(_q), 0.0);
+    }
+
+    // Add the plane ax + by + cz + d = 0, where (a, b, c) is a unit normal, scaled by weight.
+    void add_plane(double a, double b, double c, double d, double weight)
+    {
+        _q[0] += weight * a * a; _q[1] += weight * a * b; _q[2] += weight * a * c; _q[3] += weight * a * d;
+        _q[4] += weight * b * b; _q[5] += weight * b * c; _q[6] += weight * b * d;
+        _q[7] += weight * c * c; _q[8] += weight * c * d;
+        _q[9] += weight * d * d;
+    }
+
+    Quadric & operator+=(const Quadric &other)
+    {
+        for (size_t i = 0; i < 10; i++) _q[i] += other._q[i];
+        return *this;
+    }
+
+    Quadric operator+(const Quadric &other) const
+    {
+        Quadric sum = *this;
+        return sum += other;
+    }
+
+    // Error of placing a vertex at (x, y, z)
+    double error(double x, double y, double z) const
+    {
+        return _q[0] * x * x + 2 * _q[1] * x * y + 2 * _q[2] * x * z + 2 * _q[3] * x +
+               _q[4] * y * y + 2 * _q[5] * y * z + 2 * _q[6] * y +
+               _q[7] * z * z + 2 * _q[8] * z +
+               _q[9];
+    }
+
+private:
+
+    // Upper triangle of the matrix, row by row
+    double _q[10];
+
+};
+
+// Simplifies an indexed polygon mesh by collapsing edges into one of their vertices, cheapest first.
+// Vertices are never moved, so the faces left always index the original vertices.
+class MeshDecimator
+{
+public:
+
+    using Position = array<double, 3>;
+    using Face = vector<size_t>;
+
+    // Weight of the planes keeping open boundaries in place, relative to the planes of the faces
+    constexpr static double boundary_weight = 100;
+
+    MeshDecimator(const vector<Position> &positions, const vector<Face> &faces):
+        _positions(positions), _faces(faces), _alive(faces.size(), true), _live_faces(faces.size()),
+        _vertex_faces(positions.size()), _quadrics(positions.size()),
+        _stamps(positions.size(), 0), _removed(positions.size(), false)
+    {
+        vector<pair<size_t, size_t>> edges;
+        vector<size_t> edge_faces;
+
+        for (size_t f = 0; f < _faces.size(); f++)
+        {
+            if (!simplify(_faces[f]))
+            {
+                kill(f);
+                continue;
+            }
+
+            const Face &face = _faces[f];
+            for (size_t i = 0; i < face.size(); i++)
+            {
+                const size_t a = face[i], b = face[(i + 1) % face.size()];
+
+                _vertex_faces[a].push_back(f);
+                edges.push_back(make_pair(min(a, b), max(a, b)));
+                edge_faces.push_back(f);
+            }
+
+            add_face_quadric(f);
+        }
+
+        vector<size_t> order(edges.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        sort(order.begin(), order.end(), [&edges](size_t i, size_t j) { return edges[i] < edges[j]; });
+
+        for (size_t i = 0; i < order.size(); )
+        {
+            size_t j = i + 1;
+            while (j < order.size() && edges[order[j]] == edges[order[i]]) j++;
+
+            const pair<size_t, size_t> &edge = edges[order[i]];
+            if (j == i + 1) add_boundary_quadric(edge.first, edge.second, edge_faces[order[i]]);
+
+            i = j;
+        }
+
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            if (i == 0 || edges[order[i]] != edges[order[i - 1]])
+                push(edges[order[i]].first, edges[order[i]].second);
+        }
+    }
+
+    // Number of faces left
+    size_t face_count() const
+    {
+        return _live_faces;
+    }
+
+    // Faces left
+    vector<Face> faces() const
+    {
+        vector<Face> faces;
+        faces.reserve(_live_faces);
+
+        for (size_t f = 0; f < _faces.size(); f++)
+            if (_alive[f]) faces.push_back(_faces[f]);
+
+        return faces;
+    }
+
+    // Collapse edges until no more than target faces are left, or no edge can be collapsed.
+    void decimate(size_t target)
+    {
+        while (_live_faces > target && !_queue.empty())
+        {
+            const Collapse collapse = _queue.top();
+            _queue.pop();
+
+            if (_removed[collapse.from] || _removed[collapse.to] ||
+                _stamps[collapse.from] != collapse.from_stamp || _stamps[collapse.to] != collapse.to_stamp) continue;
+
+            if (flips(collapse.from, collapse.to)) continue;
+
+            collapse_edge(collapse.from, collapse.to);
+        }
+    }
+
+private:
+
+    // Collapse of vertex from into vertex to, valid while the stamps of both vertices are unchanged
+    struct Collapse
+    {
+        double cost;
+        size_t from, to;
+        unsigned long from_stamp, to_stamp;
+
+        bool operator>(const Collapse &other) const { return cost > other.cost; }
+    };
+
+    // Remove repeated vertices from face; false if it is left with no area.
+    static bool simplify(Face &face)
+    {
+        Face simplified;
+
+        for (size_t i = 0; i < face.size(); i++)
+        {
+            if (face[i] != face[(i + 1) % face.size()]) simplified.push_back(face[i]);
+        }
+
+        face = simplified;
+
+        if (face.size() < 3) return false;
+
+        Face sorted = face;
+        sort(sorted.begin(), sorted.end());
+        return adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
+    }
+
+    // Normal of face by Newell's method, with vertex replaced by the position of substitute; its length is twice the area.
+    Position normal(size_t f, size_t vertex, size_t substitute) const
+    {
+        const Face &face = _faces[f];
+        Position n = {{ 0, 0, 0 }};
+
+        for (size_t i = 0; i < face.size(); i++)
+        {
+            const size_t a = face[i] == vertex ? substitute : face[i];
+            const size_t b = face[(i + 1) % face.size()] == vertex ? substitute : face[(i + 1) % face.size()];
+            const Position &p = _positions[a], &q = _positions[b];
+
+            n[0] += (p[1] - q[1]) * (p[2] + q[2]);
+            n[1] += (p[2] - q[2]) * (p[0] + q[0]);
+            n[2] += (p[0] - q[0]) * (p[1] + q[1]);
+        }
+
+        return n;
+    }
+
+    Position normal(size_t f) const
+    {
+        return normal(f, _positions.size(), _positions.size());
+    }
+
+    static double length(const Position &v)
+    {
+        return sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    }
+
+    // Add the plane of face f, weighted by its area, to the quadrics of its vertices.
+    void add_face_quadric(size_t f)
+    {
+        const Position n = normal(f);
+        const double double_area = length(n);
+        if (double_area == 0) return;
+
+        const Position &p = _positions[_faces[f].front()];
+        const double a = n[0] / double_area, b = n[1] / double_area, c = n[2] / double_area;
+        const double d = -(a * p[0] + b * p[1] + c * p[2]);
+
+        for (size_t v: _faces[f])
+            _quadrics[v].add_plane(a, b, c, d, double_area / 2);
+    }
+
+    // Add the plane through the boundary edge (u, v) perpendicular to face f to the quadrics of u and v.
+    void add_boundary_quadric(size_t u, size_t v, size_t f)
+    {
+        const Position n = normal(f);
+        const Position &p = _positions[u], &q = _positions[v];
+        const Position e = {{ q[0] - p[0], q[1] - p[1], q[2] - p[2] }};
+        const Position m = {{ e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0] }};
+        const double m_length = length(m);
+        if (m_length == 0) return;
+
+        const double a = m[0] / m_length, b = m[1] / m_length, c = m[2] / m_length;
+        const double d = -(a * p[0] + b * p[1] + c * p[2]);
+        const double weight = boundary_weight * (e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+
+        _quadrics[u].add_plane(a, b, c, d, weight);
+        _quadrics[v].add_plane(a, b, c, d, weight);
+    }
+
+    // Queue the cheapest collapse of edge (u, v).
+    void push(size_t u, size_t v)
+    {
+        const Quadric quadric = _quadrics[u] + _quadrics[v];
+        const Position &p = _positions[u], &q = _positions[v];
+        const double u_to_v = quadric.error(q[0], q[1], q[2]);
+        const double v_to_u = quadric.error(p[0], p[1], p[2]);
+
+        if (u_to_v <= v_to_u)
+            _queue.push({ u_to_v, u, v, _stamps[u], _stamps[v] });
+        else
+            _queue.push({ v_to_u, v, u, _stamps[v], _stamps[u] });
+    }
+
+    // True if collapsing from into to turns any of the faces left around from upside down.
+    bool flips(size_t from, size_t to) const
+    {
+        for (size_t f: _vertex_faces[from])
+        {
+            if (!_alive[f] || find(_faces[f].begin(), _faces[f].end(), to) != _faces[f].end()) continue;
+
+            const Position before = normal(f), after = normal(f, from, to);
+            if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0) return true;
+        }
+
+        return false;
+    }
+
+    void kill(size_t f)
+    {
+        _alive[f] = false;
+        _live_faces--;
+    }
+
+    // Replace from with to in all faces, removing the faces left with no area, and queue the new edges around to.
+    void collapse_edge(size_t from, size_t to)
+    {
+        for (size_t f: _vertex_faces[from])
+        {
+            if (!_alive[f]) continue;
+
+            replace(_faces[f].begin(), _faces[f].end(), from, to);
+
+            if (simplify(_faces[f]))
+                _vertex_faces[to].push_back(f);
+            else
+                kill(f);
+        }
+
+        _vertex_faces[from].clear();
+        _quadrics[to] += _quadrics[from];
+        _removed[from] = true;
+        _stamps[to]++;
+
+        vector<size_t> &faces = _vertex_faces[to];
+        faces.erase(remove_if(faces.begin(), faces.end(), [this](size_t f) { return !_alive[f]; }), faces.end());
+        sort(faces.begin(), faces.end());
+        faces.erase(unique(faces.begin(), faces.end()), faces.end());
+
+        vector<size_t> neighbors;
+        for (size_t f: faces)
+        {
+            const Face &face = _faces[f];
+            for (size_t i = 0; i < face.size(); i++)
+            {
+                if (face[i] != to) continue;
+
+                neighbors.push_back(face[(i + 1) % face.size()]);
+                neighbors.push_back(face[(i + face.size() - 1) % face.size()]);
+            }
+        }
+
+        sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(unique(neighbors.begin(), neighbors.end()), neighbors.end());
+
+        for (size_t neighbor: neighbors)
+            push(to, neighbor);
+    }
+
+    const vector<Position> _positions;
+    vector<Face> _faces;
+    vector<bool> _alive;
+    size_t _live_faces;
+
+    vector<vector<size_t>> _vertex_faces;
+    vector<Quadric> _quadrics;
+    vector<unsigned long> _stamps;
+    vector<bool> _removed;
+
+    priority_queue<Collapse, vector<Collapse>, greater<Collapse>> _queue;
+
+};
+
+// Chain of simplified meshes, each with about half the faces of the previous one, down to minimum faces
+inline vector<vector<MeshDecimator::Face>> decimated_levels(
+    const vector<MeshDecimator::Position> &positions, const vector<MeshDecimator::Face> &faces, size_t minimum)
+{
+    vector<vector<MeshDecimator::Face>> levels;
+    MeshDecimator decimator(positions, faces);
+
+    size_t count = decimator.face_count();
+    while (count / 2 >= minimum)
+    {
+        decimator.decimate(count / 2);
+
+        // Stop when the collapses left would turn faces upside down.
+        if (decimator.face_count() > count * 3 / 4) break;
+
+        count = decimator.face_count();
+        levels.push_back(decimator.faces());
+    }
+
+    return levels;
+}
+
+// Levels of detail of a mesh, built in a background thread and used once ready
+class LevelsOfDetail
+{
+public:
+
+    using Position = MeshDecimator::Position;
+    using Face = MeshDecimator::Face;
+
+    // Meshes with fewer faces are drawn in full detail.
+    constexpr static size_t minimum_faces = 256;
+
+    // True if the levels were requested, even if not ready yet.
+    bool started() const
+    {
+        return _state != nullptr;
+    }
+
+    // Start building the levels for the mesh in the background.
+    void build(vector<Position> positions, vector<Face> faces)
+    {
+        _state = make_shared<State>();
+
+        thread(build_levels, _state, move(positions), move(faces)).detach();
+    }
+
+    // True once the levels are built.
+    bool ready() const
+    {
+        return _state != nullptr && _state->ready.load(memory_order_acquire);
+    }
+
+    // Faces of each level, from the finest to the coarsest; available once ready.
+    const vector<vector<Face>> & levels() const
+    {
+        return _state->levels;
+    }
+
+private:
+
+    // State shared with the building thread, which may outlive the mesh
+    struct State
+    {
+        vector<vector<Face>> levels;
+        atomic<bool> ready{false};
+    };
+
+    static void build_levels(shared_ptr<State> state, vector<Position> positions, vector<Face> faces)
+    {
+        state->levels = decimated_levels(positions, faces, minimum_faces);
+        state->ready.store(true, memory_order_release);
+    }
+
+    shared_ptr<State> _state;
+
+};
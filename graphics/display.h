@@ -2,8 +2,11 @@
 
 #include "graphics3d.h"
 #include "graphics2d.h"
+#include "clipping_batch.h"
 #include "timer.h"
 
+#include <limits>
+
 // Viewport Coordinates
 class VC: public XYCoord<VC>
 {
@@ -20,6 +23,35 @@ public:
 
 };
 
+// Projections
+enum ProjectionMethod { ORTHOGONAL, PERSPECTIVE };
+
+static ProjectionMethod projection_method = ORTHOGONAL;
+
+// Canvas able to show a frame of pixels rendered off screen
+class FrameCanvas
+{
+public:
+
+    // Draw the pixels of frame over the canvas, leaving the canvas as is where they are transparent.
+    virtual void draw_frame(const FrameBuffer &frame) = 0;
+
+};
+
+// Settings affecting the screen-space output of objects, packed in a single value
+inline unsigned long rendering_settings()
+{
+    return (unsigned long) projection_method |
+           (unsigned long) clipping_method << 1 |
+           (unsigned long) surface_method << 3 |
+           (unsigned long) detail_method << 5 |
+           (unsigned long) hidden_line_method << 6 |
+           (unsigned long) fill_method << 8 |
+           (unsigned long) polygon_clipping_method << 9 |
+           (unsigned long) curve_method << 10 |
+           (unsigned long) lround(guard_band()) << 11;
+}
+
 // Visible area on a canvas
 class Viewport
 {
@@ -47,6 +79,287 @@ private:
 
 };
 
+// Viewport-space output of a canvas, kept in a flat buffer of operations and their operands, to be replayed
+// without traversing the display file again or written out as SVG
+class DrawList: public Canvas<VC>, public FrameCanvas
+{
+public:
+
+    // Forget everything drawn.
+    void clear()
+    {
+        _operations.clear();
+        _operands.clear();
+        _frames.clear();
+    }
+
+    // Number of recorded operations
+    size_t size() const
+    {
+        return _operations.size();
+    }
+
+    // Record move to destination.
+    void move(const VC &destination) override
+    {
+        _operations.push_back(MOVE);
+        _operands.insert(_operands.end(), { destination.x(), destination.y() });
+    }
+
+    // Record line from current position to destination.
+    void draw_line(const VC &destination) override
+    {
+        _operations.push_back(LINE);
+        _operands.insert(_operands.end(), { destination.x(), destination.y() });
+    }
+
+    // Record circle with the specified center and radius.
+    void draw_circle(const VC &center, const double radius) override
+    {
+        _operations.push_back(CIRCLE);
+        _operands.insert(_operands.end(), { center.x(), center.y(), radius });
+    }
+
+    // Record the color to be used when drawing.
+    void set_color(const Color &color) override
+    {
+        _operations.push_back(COLOR);
+        _operands.insert(_operands.end(), { color.red(), color.green(), color.blue() });
+    }
+
+    // Record the pixels of frame, shared with it rather than copied.
+    void draw_frame(const FrameBuffer &frame) override
+    {
+        _operations.push_back(FRAME);
+        _frames.push_back(frame.picture());
+    }
+
+    // Send the recorded output to canvas; frames are dropped if canvas cannot show them.
+    void replay(Canvas<VC> &canvas) const
+    {
+        FrameCanvas *frame_canvas = dynamic_cast<FrameCanvas *>(&canvas);
+        const double *operand = _operands.data();
+        auto frame = _frames.begin();
+
+        for (auto operation: _operations)
+        {
+            switch (operation)
+            {
+                case MOVE: canvas.move(VC(operand[0], operand[1])); operand += 2; break;
+                case LINE: canvas.draw_line(VC(operand[0], operand[1])); operand += 2; break;
+                case CIRCLE: canvas.draw_circle(VC(operand[0], operand[1]), operand[2]); operand += 3; break;
+                case COLOR: canvas.set_color(Color(operand[0], operand[1], operand[2])); operand += 3; break;
+                case FRAME: if (frame_canvas != nullptr) frame_canvas->draw_frame(*frame); ++frame; break;
+            }
+        }
+    }
+
+    // Write the recorded lines and circles as an SVG image of the size of viewport, clipped to its content as the
+    // screen is, since lines may be left for the canvas to clip; frames are left out.
+    void write_svg(ostream &out, const Viewport &viewport) const
+    {
+        out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << viewport.width()
+            << "\" height=\"" << viewport.height() << "\">\n";
+        out << "<clipPath id=\"content\"><rect x=\"" << viewport.left() << "\" y=\"" << viewport.top()
+            << "\" width=\"" << viewport.content_width() << "\" height=\"" << viewport.content_height()
+            << "\"/></clipPath>\n";
+        out << "<g clip-path=\"url(#content)\">\n";
+
+        const double *operand = _operands.data();
+        string color = "rgb(0,0,0)";
+        stringstream path;
+        bool open = false;
+        double x = 0, y = 0;
+
+        auto close = [&]()
+        {
+            if (!open) return;
+            out << "<path fill=\"none\" stroke=\"" << color << "\" d=\"" << path.str() << "\"/>\n";
+            path.str("");
+            open = false;
+        };
+
+        for (auto operation: _operations)
+        {
+            switch (operation)
+            {
+                case MOVE:
+                    x = operand[0];
+                    y = operand[1];
+                    path << (open ? " M" : "M") << x << ' ' << y;
+                    open = true;
+                    operand += 2;
+                    break;
+
+                case LINE:
+                    // Every path starts at the current position, even when a color or circle closed the previous one.
+                    if (!open) path << 'M' << x << ' ' << y;
+                    open = true;
+                    x = operand[0];
+                    y = operand[1];
+                    path << " L" << x << ' ' << y;
+                    operand += 2;
+                    break;
+
+                case CIRCLE:
+                    close();
+                    out << "<circle cx=\"" << operand[0] << "\" cy=\"" << operand[1] << "\" r=\"" << operand[2]
+                        << "\" fill=\"" << color << "\"/>\n";
+                    operand += 3;
+                    break;
+
+                case COLOR:
+                    close();
+                    color = svg_color(operand[0], operand[1], operand[2]);
+                    operand += 3;
+                    break;
+
+                case FRAME:
+                    break;
+            }
+        }
+
+        close();
+        out << "</g>\n</svg>\n";
+    }
+
+private:
+
+    static string svg_color(double red, double green, double blue)
+    {
+        stringstream ss;
+        ss << "rgb(" << lround(red * 255) << ',' << lround(green * 255) << ',' << lround(blue * 255) << ')';
+        return ss.str();
+    }
+
+    enum Operation: unsigned char { MOVE, LINE, CIRCLE, COLOR, FRAME };
+
+    vector<Operation> _operations;
+    vector<double> _operands;
+    vector<FrameBuffer> _frames;
+
+};
+
+// Screen-space output of an object, kept to be replayed while neither the object nor the camera change
+class ScreenVertices: public DrawList
+{
+public:
+
+    // True if recorded for the given object version, camera version and rendering settings.
+    bool valid(unsigned long object_version, unsigned long camera_version, unsigned long settings) const
+    {
+        return _valid &&
+               _object_version == object_version &&
+               _camera_version == camera_version &&
+               _settings == settings;
+    }
+
+    // Discard the recorded output in order to record it again for the given versions and settings.
+    void reset(unsigned long object_version, unsigned long camera_version, unsigned long settings)
+    {
+        clear();
+
+        _object_version = object_version;
+        _camera_version = camera_version;
+        _settings = settings;
+        _valid = true;
+    }
+
+    // Colors are selected by the rendering listener on every frame, so they are not recorded.
+    void set_color(const Color UNUSED &color) override
+    {
+    }
+
+private:
+
+    bool _valid = false;
+    unsigned long _object_version = 0, _camera_version = 0, _settings = 0;
+
+};
+
+// Records the screen-space output of a canvas
+class ScreenRecorder
+{
+public:
+
+    // Version of the camera used to map world coords to the screen
+    virtual unsigned long camera_version() const = 0;
+
+    // Send the screen-space output to recording, or back to the screen if recording is nullptr.
+    virtual void record(ScreenVertices *recording) = 0;
+
+    // Send the recorded screen-space output to the screen.
+    virtual void replay(const ScreenVertices &recording) = 0;
+
+};
+
+// Command reusing its screen-space output while neither its object nor the camera change
+template<class Coord>
+class ScreenCachedCommand: public DisplayCommand<Coord>
+{
+public:
+
+    // Render object on canvas, replaying the recorded screen-space output if still valid.
+    void render(Canvas<Coord> &canvas) override
+    {
+        if (!refresh(canvas))
+        {
+            draw(canvas);
+            return;
+        }
+
+        canvas.screen_recorder()->replay(_screen);
+    }
+
+    // True if the recorded screen-space output is valid for the camera of recorder.
+    bool recorded(const ScreenRecorder &recorder) const
+    {
+        const shared_ptr<::Object<Coord>> object = this->object();
+        if (object == nullptr) return false;
+
+        object->update();
+
+        return _screen.valid(object->version(), recorder.camera_version(), rendering_settings());
+    }
+
+    // Record the screen-space output of the object through canvas, unless the recorded output is still valid.
+    // False if the output cannot be recorded through canvas.
+    bool refresh(Canvas<Coord> &canvas)
+    {
+        ScreenRecorder *recorder = canvas.screen_recorder();
+        const shared_ptr<::Object<Coord>> object = this->object();
+
+        if (recorder == nullptr || object == nullptr) return false;
+
+        object->update();
+
+        const unsigned long object_version = object->version();
+        const unsigned long camera_version = recorder->camera_version();
+        const unsigned long settings = rendering_settings();
+
+        if (!_screen.valid(object_version, camera_version, settings))
+        {
+            _screen.reset(object_version, camera_version, settings);
+
+            recorder->record(&_screen);
+            draw(canvas);
+            recorder->record(nullptr);
+        }
+
+        return true;
+    }
+
+protected:
+
+    // Draw object on canvas, bypassing the recorded screen-space output.
+    virtual void draw(Canvas<Coord> &canvas) = 0;
+
+private:
+
+    ScreenVertices _screen;
+
+};
+
 enum ProjectionView { FRONT, BACK };
 
 // Visible area of the world
@@ -98,10 +411,7 @@ public:
     // True if Window contains World coord.
     bool contains(Coord2D coord) const override
     {
-        PPC wc = from_world(coord);
-        double x = wc.x(), y = wc.y();
-        return ((x > PPC::norm_left && x < PPC::norm_right) || equals(x, PPC::norm_left) || equals(x, PPC::norm_right)) &&
-               ((y > PPC::norm_bottom && y < PPC::norm_top) || equals(y, PPC::norm_bottom) || equals(y, PPC::norm_top));
+        return in_window(from_world(coord));
     }
 
     // Translate coord from World to Window, where left-bottom is (-1, -1) and right-top is (1, 1).
@@ -340,6 +650,10 @@ public:
 
     void set_viewport(const Viewport &viewport)
     {
+        if (_viewport_top_left == viewport.topLeft() &&
+            equals(_viewport_width, viewport.content_width()) &&
+            equals(_viewport_height, viewport.content_height())) return;
+
         _viewport_top_left = viewport.topLeft();
         _viewport_width = viewport.content_width();
         _viewport_height = viewport.content_height();
@@ -421,6 +735,8 @@ public:
         _to_world_matrix = to_world_matrix();
         _from_viewport_matrix = from_viewport_matrix();
         _to_viewport_matrix = to_viewport_matrix();
+
+        Object::changed();
     }
 
 private:
@@ -443,16 +759,18 @@ private:
 };
 
 // Command to draw 2D objects
-class Draw2DCommand: public DisplayCommand<Coord2D>
+class Draw2DCommand: public ScreenCachedCommand<Coord2D>
 {
 public:
 
-    Draw2DCommand(shared_ptr<Drawable2D> drawable): _drawable(drawable) {}
+    Draw2DCommand(shared_ptr<Drawable2D> drawable):
+        _drawable(drawable), _clippable(dynamic_pointer_cast<Clippable<Drawable2D>>(drawable)),
+        _polyline(dynamic_pointer_cast<Polyline2D>(drawable)) {}
 
-    // Render drawable on canvas if visible.
-    void render(Canvas<Coord2D> &canvas) override
+    // Draw drawable on canvas if visible.
+    void draw(Canvas<Coord2D> &canvas) override
     {
-        ClippingArea *clipping_area = dynamic_cast<ClippingArea *>(&canvas);
+        ClippingArea *clipping_area = canvas.clipping_area();
 
         if (clipping_area == nullptr)
         {
@@ -464,8 +782,22 @@ public:
         }
     }
 
-    void draw_clipped(Canvas<Coord2D> &canvas, ClippingArea &clipping_area) const
+    // Draw drawable on canvas clipped in clipping_area.
+    // Polylines are classified and clipped in a single pass into a buffer kept by the command.
+    void draw_clipped(Canvas<Coord2D> &canvas, ClippingArea &clipping_area)
     {
+        if (_polyline != nullptr)
+        {
+            switch (_polyline->clip_into(clipping_area, _clipped))
+            {
+                case Visibility::FULL: _drawable->draw(canvas); break;
+                case Visibility::PARTIAL: _polyline->draw_clipped(canvas, _clipped); break;
+                case Visibility::NONE:; // Nothing to draw.
+            }
+
+            return;
+        }
+
         switch (_drawable->visibility_in(clipping_area))
         {
             case Visibility::FULL:
@@ -476,12 +808,11 @@ public:
 
             case Visibility::PARTIAL:
             {
-                shared_ptr<Clippable<Drawable2D>> clippable = dynamic_pointer_cast<Clippable<Drawable2D>>(_drawable);
-                if (clippable == nullptr)
+                if (_clippable == nullptr)
                     _drawable->draw(canvas);
                 else
                 {
-                    shared_ptr<Drawable2D> clipped = clippable->clipped_in(clipping_area);
+                    shared_ptr<Drawable2D> clipped = _clippable->clipped_in(clipping_area);
                     if (clipped->visibility_in(clipping_area) == Visibility::FULL)
                     {
                         clipped->draw(canvas);
@@ -503,11 +834,14 @@ public:
 private:
 
     shared_ptr<Drawable2D> _drawable;
+    shared_ptr<Clippable<Drawable2D>> _clippable;
+    shared_ptr<Polyline2D> _polyline;
+    ClippingBuffer _clipped;
 
 };
 
 // Command to draw 3D objects
-class Draw3DCommand: public DisplayCommand<Coord3D>
+class Draw3DCommand: public ScreenCachedCommand<Coord3D>
 {
 public:
 
@@ -517,12 +851,34 @@ public:
 
     Draw3DCommand(shared_ptr<Drawable> drawable): _drawable(drawable) {}
 
-    // Render drawable on canvas if visible.
-    void render(Canvas &canvas) override
+    // Draw drawable on canvas, unless its bounding box is out of the view volume.
+    void draw(Canvas &canvas) override
     {
         printf("Draw3DCommand: %s: started\n", object()->name().c_str());
         const clock_t start = clock();
-        _drawable->draw(canvas);
+
+        ViewVolume *view_volume = canvas.view_volume();
+
+        switch (view_volume == nullptr ? Visibility::PARTIAL : view_volume->visibility(object()->bounding_box()))
+        {
+            case Visibility::FULL:
+            {
+                view_volume->set_clipping(false);
+                _drawable->draw(canvas);
+                view_volume->set_clipping(true);
+            }
+            break;
+
+            case Visibility::PARTIAL:
+            {
+                _drawable->draw(canvas);
+            }
+            break;
+
+            case Visibility::NONE:
+                break;
+        }
+
         const double time = elapsed_secs(start);
         printf("Draw3DCommand: %s: finished (t = %9.6lf)\n", object()->name().c_str(), time);
     }
@@ -538,118 +894,630 @@ private:
 
 };
 
-// Projections
-enum ProjectionMethod { ORTHOGONAL, PERSPECTIVE };
-
-static ProjectionMethod projection_method = ORTHOGONAL;
-
 #ifdef WORLD_3D
 
 template<class Coord>
-class ProjectionCanvas: public Canvas<Coord>
+class ProjectionCanvas: public Canvas<Coord>, public ViewVolume
 {
 public:
 
-    ProjectionCanvas(Canvas<Coord2D> &canvas): _canvas(canvas), _current(Coord2D(0, 0)) {}
+    // Capabilities of canvas and the mappings of window are resolved once, as the projection lasts for a single frame.
+    ProjectionCanvas(Canvas<Coord2D> &canvas, Window<Coord3D> &window):
+        _canvas(canvas), _clipping_area(canvas.clipping_area()), _viewport(canvas.viewport()),
+        _band(clipping_method == ClippingMethod::GUARD_BAND ? guard_band() : 1),
+        _world_to_window(affine<Coord2D, PPC>([&window](const Coord2D &coord) { return window.world_to_window(coord); })),
+        _window_to_viewport(affine<PPC, VC>([&window](const PPC &coord) { return window.to_viewport(coord); })) {}
 
-    // Move from current position to destination.
-    void move(const Coord &destination) override
+    // Position of coord in clip space, by a single product with the projection fused with the window normalization
+    ClipPoint to_clip(const Coord &coord) const
     {
-        _current = project(destination);
-        _canvas.move(_current);
+        const double x = coord.x(), y = coord.y(), z = coord.z();
+
+        return { x * _fused[0][0] + y * _fused[1][0] + z * _fused[2][0] + _fused[3][0],
+                 x * _fused[0][1] + y * _fused[1][1] + z * _fused[2][1] + _fused[3][1],
+                 x * _fused[0][2] + y * _fused[1][2] + z * _fused[2][2] + _fused[3][2] };
     }
 
-    // Draw line from current position to destination, clipping if necessary.
-    void draw_line(const Coord &destination) override
+    // Position of coord in the window, where left-bottom is (-1, -1) and right-top is (1, 1)
+    PPC to_window(const Coord &coord) const
     {
-        ClippingArea *clipping_area = dynamic_cast<ClippingArea *>(&_canvas);
-        Coord2D projected_destination = project(destination);
+        return to_window(to_clip(coord));
+    }
 
-        if (clipping_area == nullptr)
+    // Position in the window of a point in clip space
+    static PPC to_window(const ClipPoint &point)
+    {
+        return PPC(point.x / point.w, point.y / point.w);
+    }
+
+    // Planes of the view volume to clip against: all of them, or only the near plane when clipping is off,
+    // as lines behind the eye cannot be projected.
+    static unsigned clip_planes()
+    {
+        return clipping_method == ClippingMethod::NONE ? unsigned(CLIP_NEAR) : CLIP_ALL;
+    }
+
+    // Position of Window coord on the viewport
+    VC to_viewport(const PPC &coord) const
+    {
+        const array<double, 6> &m = _window_to_viewport;
+        return VC(m[0] + coord.x() * m[2] + coord.y() * m[4], m[1] + coord.x() * m[3] + coord.y() * m[5]);
+    }
+
+    // Set the color to be used when drawing.
+    void set_color(const Color &color) override
+    {
+        _color = color;
+        _canvas.set_color(color);
+    }
+
+    // Color set for drawing
+    Color color() const override
+    {
+        return _color;
+    }
+
+    // Recorder of the projected output; nullptr when rendering solid, as solid objects are not drawn on the canvas,
+    // and when removing hidden lines with a depth buffer, as the output of each object then depends on the others.
+    ScreenRecorder * screen_recorder() override
+    {
+        return _frame_buffer == nullptr && _depth_buffer == nullptr ? _canvas.screen_recorder() : nullptr;
+    }
+
+    // Volume seen through the projection
+    ViewVolume * view_volume() override
+    {
+        return this;
+    }
+
+    // World length of a pixel on the plane of the window; objects farther away under perspective cover fewer pixels.
+    double pixel_size() const override
+    {
+        return _canvas.pixel_size();
+    }
+
+    // Affine map to pixel space, known when the projection keeps w at 1 and the viewport has some content;
+    // not offered when rendering solid, as lines are then depth tested from their world coords.
+    const TMatrix * pixel_map() const override
+    {
+        const bool known = _affine && _viewport != nullptr && _pixels_x > 0 && _pixels_y > 0;
+        return known && _frame_buffer == nullptr ? &_pixel_map : nullptr;
+    }
+
+    // Determine the visibility of box, based on the outcodes of its corners in clip space.
+    // The view volume is convex, so a box with all corners outside one plane is out of it.
+    Visibility visibility(const BoundingBox &box) const override
+    {
+        if (_clipping_area == nullptr) return Visibility::FULL;
+        if (box.empty()) return Visibility::NONE;
+
+        const unsigned planes = clip_planes();
+        unsigned common_code = planes, any_code = 0;
+
+        for (size_t i = 0; i < BoundingBox::corner_count; i++)
         {
-            _canvas.draw_line(projected_destination);
+            const unsigned code = outcode(to_clip(box.corner(i))) & planes;
+            common_code &= code;
+            any_code |= code;
         }
-        else
+
+        if (common_code != 0) return Visibility::NONE;
+        if (any_code == 0) return Visibility::FULL;
+
+        return Visibility::PARTIAL;
+    }
+
+    // Enable or disable clipping of the lines drawn.
+    void set_clipping(bool clipping) override
+    {
+        _clipping = clipping;
+    }
+
+    // Size in pixels of the larger side of the rectangle bounding the projected corners of box.
+    double screen_size(const BoundingBox &box) const override
+    {
+        if (_clipping_area == nullptr || _viewport == nullptr) return numeric_limits<double>::infinity();
+        if (box.empty()) return 0;
+
+        double left = numeric_limits<double>::infinity(), right = -left;
+        double bottom = left, top = right;
+
+        for (size_t i = 0; i < BoundingBox::corner_count; i++)
         {
-            switch (visibility(*clipping_area, _current, projected_destination))
-            {
-                case Visibility::FULL:
-                {
-                    _canvas.draw_line(projected_destination);
-                }
-                break;
+            const Coord corner = box.corner(i);
 
-                case Visibility::PARTIAL:
-                {
-                    const pair<Coord2D, Coord2D> clipped_line = clip_line(*clipping_area, _current, projected_destination);
+            if (!projectable(corner)) return numeric_limits<double>::infinity();
 
-                    if (visibility(*clipping_area, clipped_line.first, clipped_line.second) == Visibility::FULL)
-                    {
-                        _canvas.move(clipped_line.first);
-                        _canvas.draw_line(clipped_line.second);
-                    }
-                }
-                break;
+            const PPC projected = to_window(corner);
+            left = min(left, projected.x());
+            right = max(right, projected.x());
+            bottom = min(bottom, projected.y());
+            top = max(top, projected.y());
+        }
+
+        return max((right - left) / PPC::norm_width * _viewport->content_width(),
+                   (top - bottom) / PPC::norm_height * _viewport->content_height());
+    }
+
+    // Position of coord on the viewport, in pixels, with its depth.
+    bool screen_point(const Coord &coord, ScreenPoint &point) const override
+    {
+        if (_clipping_area == nullptr || _viewport == nullptr || !projectable(coord)) return false;
 
-                case Visibility::NONE:;
-                    // Nothing to draw.
+        const PPC projected = to_window(coord);
+
+        point.x = _viewport->left() + (projected.x() - PPC::norm_left) / PPC::norm_width * _viewport->content_width();
+        point.y = _viewport->top() + (PPC::norm_top - projected.y()) / PPC::norm_height * _viewport->content_height();
+        point.depth = depth(coord);
+        point.w = w(coord);
+
+        return true;
+    }
+
+    // Depth buffer for hidden line removal, if started.
+    DepthBuffer * depth_buffer() override
+    {
+        return _depth_buffer.get();
+    }
+
+    // Frame buffer for solid rendering, if started.
+    FrameBuffer * frame_buffer() override
+    {
+        return _frame_buffer.get();
+    }
+
+    // Start removing hidden lines with a depth buffer as large as the viewport, cleared once for the frame,
+    // into which the faces of all groups in display file that may be seen are rasterized before any edge is drawn.
+    void start_depth_buffer(DisplayFile<Coord> &display_file)
+    {
+        if (_viewport == nullptr) return;
+
+        _depth_buffer = make_shared<DepthBuffer>(long(ceil(_viewport->width())), long(ceil(_viewport->height())));
+
+        for (auto &command: display_file.commands())
+        {
+            shared_ptr<Group3D> group = dynamic_pointer_cast<Group3D>(command->object());
+            if (group == nullptr || visibility(group->bounding_box()) == Visibility::NONE) continue;
+
+            group->rasterize_faces(*this);
+        }
+    }
+
+    // Start rendering solid into a frame buffer covering the content of the viewport, inside its margins,
+    // with integer depths spanning the depths of the boxes bounding the objects in display file.
+    void start_frame(DisplayFile<Coord> &display_file)
+    {
+        if (_viewport == nullptr) return;
+
+        const long left = long(ceil(_viewport->left())), top = long(ceil(_viewport->top()));
+        const long right = long(floor(_viewport->left() + _viewport->content_width()));
+        const long bottom = long(floor(_viewport->top() + _viewport->content_height()));
+
+        _frame_buffer = make_shared<FrameBuffer>(max(0L, right - left), max(0L, bottom - top), left, top);
+
+        double nearest = numeric_limits<double>::infinity(), farthest = -nearest;
+
+        for (auto &command: display_file.commands())
+        {
+            if (command->object() == nullptr) continue;
+
+            const BoundingBox &box = command->object()->bounding_box();
+            if (box.empty()) continue;
+
+            for (size_t i = 0; i < BoundingBox::corner_count; i++)
+            {
+                ScreenPoint point;
+                if (!screen_point(box.corner(i), point)) continue;
+
+                nearest = min(nearest, point.depth);
+                farthest = max(farthest, point.depth);
             }
         }
+
+        _frame_buffer->set_depth_range(nearest, farthest);
     }
 
-    // Draw circle with the specified center, radius and color.
-    void draw_circle(const Coord &center, const double radius) override
+    // Depth of coord, growing away from the eye and varying linearly on the screen along projected lines
+    virtual double depth(const Coord &coord) const = 0;
+
+    // True if coord can be projected consistently, i.e. it is not behind the eye.
+    virtual bool projectable(const Coord UNUSED &coord) const
     {
-        _canvas.draw_circle(project(center), radius);
+        return true;
     }
 
-    // Set the color to be used when drawing.
-    void set_color(const Color &color) override
+protected:
+
+    // Draw the line from a to b into the frame buffer, cut by the near plane, where it is not behind any surface.
+    void draw_line_in_frame(const Coord &a, const Coord &b)
     {
-        _canvas.set_color(color);
+        const double wa = w(a), wb = w(b);
+        if (wa < near_w && wb < near_w) return;
+
+        ScreenPoint from, to;
+        if (!screen_point(wa < near_w ? between(a, b, (near_w - wa) / (wb - wa)) : a, from)) return;
+        if (!screen_point(wb < near_w ? between(b, a, (near_w - wb) / (wa - wb)) : b, to)) return;
+
+        _frame_buffer->draw_line(from, to, argb(_color.red(), _color.green(), _color.blue()));
     }
 
-    virtual Coord2D project(Coord coord) const = 0;
+    // Fill the circle around center with radius in pixels into the frame buffer, as a polygon at the depth of center.
+    void fill_circle_in_frame(const Coord &center, double radius)
+    {
+        constexpr size_t sides = 16;
 
-protected:
+        ScreenPoint middle;
+        if (!screen_point(center, middle)) return;
+
+        const uint32_t color = argb(_color.red(), _color.green(), _color.blue());
+        ScreenPoint previous = { middle.x + radius, middle.y, middle.depth, middle.w };
+
+        for (size_t side = 1; side <= sides; side++)
+        {
+            const double angle = 2 * PI * side / sides;
+            const ScreenPoint next = { middle.x + radius * cos(angle), middle.y + radius * sin(angle),
+                                       middle.depth, middle.w };
+
+            _frame_buffer->fill_triangle(middle, previous, next, color);
+            previous = next;
+        }
+    }
+
+    // Compose projection, taking world coords to homogeneous coords on the projection plane, with the window
+    // normalization, which is affine on that plane: each row keeps x * w, y * w and w of the window coords.
+    void set_projection(const TMatrix &projection)
+    {
+        const array<double, 6> &m = _world_to_window;
+
+        for (size_t row = 0; row < 4; row++)
+        {
+            const TVector unit({ row == 0 ? 1.0 : 0.0, row == 1 ? 1.0 : 0.0, row == 2 ? 1.0 : 0.0, row == 3 ? 1.0 : 0.0 });
+            const TVector h = unit * projection;
+
+            _fused[row][0] = m[0] * h[3] + m[2] * h[0] + m[4] * h[1];
+            _fused[row][1] = m[1] * h[3] + m[3] * h[0] + m[5] * h[1];
+            _fused[row][2] = h[3];
+        }
+
+        _affine = _fused[0][2] == 0 && _fused[1][2] == 0 && _fused[2][2] == 0 && _fused[3][2] == 1;
+
+        if (_affine && _viewport != nullptr)
+        {
+            _pixels_x = _viewport->content_width() / PPC::norm_width;
+            _pixels_y = _viewport->content_height() / PPC::norm_height;
+
+            const TVector x({ _fused[0][0], _fused[1][0], _fused[2][0], _fused[3][0] });
+            const TVector y({ _fused[0][1], _fused[1][1], _fused[2][1], _fused[3][1] });
+
+            _pixel_map = TMatrix(x * _pixels_x, y * _pixels_y, TVector({ 0, 0, 0, 0 }), TVector({ 0, 0, 0, 1 }));
+        }
+    }
+
+    // Position in clip space of a point in pixel space, only given while pixel_map() is known
+    ClipPoint from_pixels(const Coord &point) const
+    {
+        return { point.x() / _pixels_x, point.y() / _pixels_y, 1 };
+    }
 
     Canvas<Coord2D> &_canvas;
-    Coord2D _current;
+    ClippingArea *_clipping_area;
+    Viewport *_viewport;
+
+    // Size of the view volume sides relative to the window: the guard band, or 1 when clipping to the window itself
+    const double _band;
+
+    bool _clipping = true;
+    Color _color = BLACK;
+    shared_ptr<DepthBuffer> _depth_buffer;
+    shared_ptr<FrameBuffer> _frame_buffer;
+
+private:
+
+    // Coefficients of the affine map of the plane: (x, y) -> (m0 + x * m2 + y * m4, m1 + x * m3 + y * m5)
+    template<class From, class To, class Map>
+    static array<double, 6> affine(Map map)
+    {
+        const To o = map(From(0, 0)), x = map(From(1, 0)), y = map(From(0, 1));
+        return {{ o.x(), o.y(), x.x() - o.x(), x.y() - o.y(), y.x() - o.x(), y.y() - o.y() }};
+    }
+
+    array<double, 6> _world_to_window, _window_to_viewport;
+    double _fused[4][3] = {};
+
+    // Whether the projection keeps w at 1, with the map to pixel space and the pixels in a unit of clip space if so
+    bool _affine = false;
+    TMatrix _pixel_map;
+    double _pixels_x = 1, _pixels_y = 1;
+
+};
+
+// Projection canvas drawing on a viewport canvas of type Next.
+// Each vertex is taken to the window by the fused projection, clipped there and sent to Next in viewport coords,
+// with the calls to Next resolved at compile time, involving neither run-time type checks nor virtual calls.
+template<class Next>
+class ProjectionStage: public ProjectionCanvas<Coord3D>
+{
+public:
+
+    ProjectionStage(Next &next, Window<Coord3D> &window): ProjectionCanvas(next, window), _next(next) {}
+
+    // Move from current position to destination.
+    void move(const Coord3D &destination) override
+    {
+        _world = destination;
+        _current = to_clip(destination);
+        _current_code = outcode(_current, _band);
+        _current_window_code = window_outcode(_current, _current_code);
+    }
+
+    // Draw line from current position to destination, clipping it in clip space, before the perspective divide,
+    // to the planes of the view volume, moved out to the guard band if any; lines entirely inside or outside a plane
+    // skip clipping.
+    // When rendering solid, the line is drawn into the frame buffer instead, behind the surfaces in front of it.
+    void draw_line(const Coord3D &destination) override
+    {
+        if (_frame_buffer != nullptr)
+        {
+            draw_line_in_frame(_world, destination);
+            _world = destination;
+            return;
+        }
+
+        ClipPoint a = _current, b = to_clip(destination);
+        const unsigned code_b = outcode(b, _band), window_code_b = window_outcode(b, code_b);
+
+        _current = b;
+
+        const unsigned planes = _clipping ? clip_planes() : 0u;
+
+        if ((_current_window_code & window_code_b & planes) == 0 && clip_segment(a, b, _current_code, code_b, planes, _band))
+        {
+            _next.move_in_viewport(to_viewport(to_window(a)));
+            _next.draw_line_in_viewport(to_viewport(to_window(b)));
+        }
+
+        _current_code = code_b;
+        _current_window_code = window_code_b;
+    }
+
+    // Draw lines through vertices, each taken to clip space once.
+    // Lines inside all planes are sent as they come; runs of lines crossing some plane are clipped in a batch.
+    void draw_polyline(const shared_ptr<Coord3D> &initial, const list<shared_ptr<Coord3D>> &vertices) override
+    {
+        if (_frame_buffer != nullptr)
+        {
+            ProjectionCanvas::draw_polyline(initial, vertices);
+            return;
+        }
+
+        PolylineState state(_clipping ? clip_planes() : 0u);
+
+        if (initial != nullptr)
+        {
+            move(*initial);
+            state.started = true;
+        }
+
+        for (auto &vertex: vertices)
+        {
+            if (vertex == nullptr)
+            {
+                state.started = state.sent = false;
+                continue;
+            }
+
+            polyline_vertex(*vertex, state);
+        }
+
+        clip_batch(state.planes);
+    }
+
+    // Draw the chains of lines through contiguous vertices as the polyline of each chain would be drawn.
+    void draw_polyline(const vector<Coord3D> &vertices, const vector<size_t> &ends) override
+    {
+        if (_frame_buffer != nullptr)
+        {
+            ProjectionCanvas::draw_polyline(vertices, ends);
+            return;
+        }
+
+        PolylineState state(_clipping ? clip_planes() : 0u);
+
+        size_t first = 0;
+        for (auto end: ends)
+        {
+            state.started = state.sent = false;
+            for (size_t i = first; i < end; i++) polyline_vertex(vertices[i], state);
+
+            first = end;
+        }
+
+        clip_batch(state.planes);
+    }
+
+    // Draw the chains of lines through contiguous vertices in pixel space as the polyline of each chain would be drawn.
+    void draw_pixel_polyline(const vector<Coord3D> &vertices, const vector<size_t> &ends) override
+    {
+        PolylineState state(_clipping ? clip_planes() : 0u);
+
+        size_t first = 0;
+        for (auto end: ends)
+        {
+            state.started = state.sent = false;
+            for (size_t i = first; i < end; i++) polyline_point(from_pixels(vertices[i]), state);
+
+            first = end;
+        }
+
+        clip_batch(state.planes);
+    }
+
+    // Draw circle with the specified center, radius and color, unless the center is behind the eye.
+    // When rendering solid, the circle is filled into the frame buffer at the depth of its center.
+    void draw_circle(const Coord3D &center, const double radius) override
+    {
+        const ClipPoint point = to_clip(center);
+
+        if ((outcode(point) & CLIP_NEAR) != 0) return;
+
+        if (_frame_buffer != nullptr)
+        {
+            fill_circle_in_frame(center, radius);
+            return;
+        }
+
+        _next.draw_circle_in_viewport(to_viewport(to_window(point)), radius);
+    }
+
+private:
+
+    // Outcode of point against the window, given its outcode against the guard band
+    unsigned window_outcode(const ClipPoint &point, unsigned band_code) const
+    {
+        return _band == 1 ? band_code : outcode(point);
+    }
+
+    // Progress of a polyline being drawn
+    struct PolylineState
+    {
+        PolylineState(unsigned planes): planes(planes) {}
+
+        // Planes clipped to
+        const unsigned planes;
+
+        // True once the polyline has a current vertex, and if the line ending there was sent
+        bool started = false, sent = false;
+
+        // Position on the viewport of the current vertex, known when the line ending there was sent
+        VC current = VC(0, 0);
+    };
+
+    // Draw the line of a polyline from the current vertex to vertex, if started, and make vertex the current one.
+    void polyline_vertex(const Coord3D &vertex, PolylineState &state)
+    {
+        polyline_point(to_clip(vertex), state);
+    }
+
+    // Draw the line of a polyline from the current vertex to point in clip space, if started, and make point the
+    // current one.
+    void polyline_point(const ClipPoint &point, PolylineState &state)
+    {
+        const unsigned code = outcode(point, _band), window_code = window_outcode(point, code);
+        const bool inside = state.started && ((_current_code | code) & state.planes) == 0;
+
+        if (inside)
+        {
+            clip_batch(state.planes);
+
+            const VC end = to_viewport(to_window(point));
+            _next.move_in_viewport(state.sent ? state.current : to_viewport(to_window(_current)));
+            _next.draw_line_in_viewport(end);
+            state.current = end;
+        }
+        else if (state.started && (_current_window_code & window_code & state.planes) == 0)
+        {
+            _segments.add(_current, point);
+        }
+
+        _current = point;
+        _current_code = code;
+        _current_window_code = window_code;
+        state.started = true;
+        state.sent = inside;
+    }
+
+    // Clip the batch of lines to planes, sending what is left of them.
+    void clip_batch(unsigned planes)
+    {
+        if (_segments.size() == 0) return;
+
+        _visible.clear();
+        _segments.clip(planes, _visible, _band);
+        _segments.clear();
+
+        for (size_t i = 0; i < _visible.size(); i++)
+        {
+            _next.move_in_viewport(to_viewport(to_window(_visible.a(i))));
+            _next.draw_line_in_viewport(to_viewport(to_window(_visible.b(i))));
+        }
+    }
+
+    Next &_next;
+    Coord3D _world;
+    ClipPoint _current = { 0, 0, 1 };
+    unsigned _current_code = 0, _current_window_code = 0;
+    SegmentBatch _segments, _visible;
 
 };
 
-class ParallelProjection: public ProjectionCanvas<Coord3D>
+template<class Next>
+class ParallelProjection final: public ProjectionStage<Next>
 {
 public:
 
-    ParallelProjection(Canvas<Coord2D> &canvas) : ProjectionCanvas(canvas) {}
+    ParallelProjection(Next &next, Window<Coord3D> &window) : ProjectionStage<Next>(next, window)
+    {
+        this->set_projection(TMatrix());
+    }
 
-    Coord2D project(Coord3D coord) const override
+    // Depth along the z axis, as the eye looks toward positive z
+    double depth(const Coord3D &coord) const override
     {
-        return TVector(coord);
+        return coord.z();
+    }
+
+    double w(const Coord3D UNUSED &coord) const override
+    {
+        return 1;
+    }
+
+    // Toward negative z, where the eye is
+    Coord3D to_eye(const Coord3D UNUSED &point) const override
+    {
+        return Coord3D(0, 0, -1);
     }
 
 };
 
-class PerspectiveProjection: public ProjectionCanvas<Coord3D>
+template<class Next>
+class PerspectiveProjection final: public ProjectionStage<Next>
 {
 public:
 
-    PerspectiveProjection(Canvas<Coord2D> &canvas, Window<Coord3D> &window) :
-        ProjectionCanvas(canvas),
-        _projection(
+    PerspectiveProjection(Next &next, Window<Coord3D> &window) :
+        ProjectionStage<Next>(next, window),
+        _center_z(window.center().z()),
+        _distance(window.projection_distance()),
+        _eye(window.center().x(), window.center().y(), window.center().z() - window.projection_distance())
+    {
+        this->set_projection(
             inverse_translation(window.center()) *
             perspective_matrix(window.projection_distance()) *
             y_rotation(window.projection_rotation()) *
-            translation(window.center()))
+            translation(window.center()));
+    }
+
+    // True if coord is in front of the eye.
+    bool projectable(const Coord3D &coord) const override
+    {
+        return w(coord) > 0;
+    }
+
+    // Depth relative to the window, divided by w so that it varies linearly on the screen
+    double depth(const Coord3D &coord) const override
     {
+        const double z = coord.z() - _center_z;
+        return abs(_distance) * z / (z + _distance);
     }
 
-    Coord2D project(Coord3D coord) const override
+    double w(const Coord3D &coord) const override
     {
-        const Coord3D projected = (coord * _projection).homogeneous();
+        return (coord.z() - _center_z) / _distance + 1;
+    }
 
-        return Coord2D(projected.x(), projected.y());
+    Coord3D to_eye(const Coord3D &point) const override
+    {
+        return Coord3D(_eye.x() - point.x(), _eye.y() - point.y(), _eye.z() - point.z());
     }
 
 private:
@@ -664,7 +1532,8 @@ private:
         );
     }
 
-    TMatrix _projection;
+    double _center_z, _distance;
+    Coord3D _eye;
 
 };
 
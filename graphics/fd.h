@@ -13,27 +13,65 @@ inline TMatrix delta_coefficient_matrix()
     );
 }
 
-constexpr double fd_step = 0.05;
+// Number of steps of forward differences over a curve, unless set for the object drawn
+constexpr size_t fd_steps = 20;
 
 // Matrix with initial derivatives of forward differences for step
-inline TMatrix delta_step_matrix()
+inline TMatrix delta_step_matrix(double step)
 {
-    const TVector vs = vector_of_step(fd_step);
+    const TVector vs = vector_of_step(step);
     const TMatrix c = delta_coefficient_matrix();
     return transposed(TMatrix(c.row(0) * vs[0], c.row(1) * vs[1], c.row(2) * vs[2], c.row(3) * vs[3]));
 }
 
+// Step of forward differences dividing curves in a number of steps, with its matrix of initial derivatives computed
+// once, to be kept by the objects drawn with it
+class ForwardDifferenceStep
+{
+public:
+
+    ForwardDifferenceStep(size_t steps = fd_steps):
+        _steps(steps),
+        _size(1.0 / double(steps)),
+        _matrix(delta_step_matrix(_size)) {}
+
+    // Number of steps over a curve
+    size_t steps() const
+    {
+        return _steps;
+    }
+
+    // Increment of the parameter of a curve at each step
+    double size() const
+    {
+        return _size;
+    }
+
+    // Matrix with initial derivatives of forward differences for the step
+    const TMatrix & matrix() const
+    {
+        return _matrix;
+    }
+
+private:
+
+    size_t _steps;
+    double _size;
+    TMatrix _matrix;
+
+};
+
 // Matrix with initial deltas of forward differences
-inline TMatrix delta_matrix(const TMatrix &c)
+inline TMatrix delta_matrix(const TMatrix &c, const ForwardDifferenceStep &step = ForwardDifferenceStep())
 {
-    const TMatrix e = delta_step_matrix();
+    const TMatrix &e = step.matrix();
     return transposed(e) * transposed(c) * e;
 }
 
 // Vector with initial deltas of forward differences
-inline TVector delta_vector(const TVector &v)
+inline TVector delta_vector(const TVector &v, const ForwardDifferenceStep &step = ForwardDifferenceStep())
 {
-    const TVector sv = vector_of_step(fd_step);
+    const TVector sv = vector_of_step(step.size());
     return TVector(
         {
             sv[0] * v[0],
@@ -79,59 +117,74 @@ inline void next_t_delta(TMatrix &dd)
     ));
 }
 
-// Vector with initial coord of forward differences
-inline TVector initial_fd_vector(const TVector &dx, const TVector &dy, const TVector &dz)
+// Forward differences of a curve in x, y and z, one coordinate per lane of each SIMD register,
+// so that every step advances all coordinates together with three vector additions
+class ForwardDifferences
 {
-    return TVector({ dx[0], dy[0], dz[0], 0 });
-}
+public:
+
+    // Start at the first point of the curve with delta vectors dx, dy and dz, of its value and first three deltas.
+    ForwardDifferences(const TVector &dx, const TVector &dy, const TVector &dz):
+        _value{ dx[0], dy[0], dz[0], 0 },
+        _first{ dx[1], dy[1], dz[1], 0 },
+        _second{ dx[2], dy[2], dz[2], 0 },
+        _third{ dx[3], dy[3], dz[3], 0 } {}
+
+    // Current point of the curve
+    template<class Coord>
+    Coord coord() const
+    {
+        return Coord(TVector({ _value[0], _value[1], _value[2], 1 }));
+    }
 
-// Next vector of forward differences
-template<class Coord>
-inline TVector next_fd_vector(const Coord &coord, const TVector &dx, const TVector &dy, const TVector &dz)
-{
-    return coord * translation(dx[1], dy[1], dz[1]);
-}
+    // Move to the next point of the curve.
+    void step()
+    {
+        _value += _first;
+        _first += _second;
+        _second += _third;
+    }
 
-// Generate vertices using forward-differences technique.
-template<class Coord>
-inline void generate_fd_vertices(
-    list<shared_ptr<Coord>> &vertices,
-    const TVector &vx,
-    const TVector &vy,
-    const TVector &vz,
-    const TMatrix &m)
-{
-    static_assert(is_convertible<TVector, Coord>::value, "Coord must have constructor: Coord(const TVector &)");
+private:
 
-    TVector dx = delta_vector(vx * m);
-    TVector dy = delta_vector(vy * m);
-    TVector dz = delta_vector(vz * m);
+    typedef double Double4 __attribute__((vector_size(4 * sizeof(double))));
 
-    generate_fd_vertices(vertices, dx, dy, dz);
-}
+    Double4 _value, _first, _second, _third;
 
-// Generate vertices using forward-differences technique.
+};
+
+// Generate vertices using forward-differences technique in steps, adding them to vertices.
 template<class Coord>
-inline void generate_fd_vertices(
-    list<shared_ptr<Coord>> &vertices,
-    TVector dx, TVector dy, TVector dz)
+inline void generate_fd_vertices(vector<Coord> &vertices, const TVector &dx, const TVector &dy, const TVector &dz,
+                                 size_t steps = fd_steps)
 {
     static_assert(is_convertible<TVector, Coord>::value, "Coord must have constructor: Coord(const TVector &)");
 
-    Coord current(initial_fd_vector(dx, dy, dz));
-    vertices.push_back(make_shared<Coord>(current));
+    ForwardDifferences differences(dx, dy, dz);
 
-    for (double t = 0.0; t <= 1; t += fd_step)
-    {
-        const Coord next(next_fd_vector(current, dx, dy, dz));
-        vertices.push_back(make_shared<Coord>(next));
-
-        dx = next_delta(dx);
-        dy = next_delta(dy);
-        dz = next_delta(dz);
+    vertices.push_back(differences.coord<Coord>());
 
-        current = next;
+    for (size_t i = 0; i < steps; i++)
+    {
+        differences.step();
+        vertices.push_back(differences.coord<Coord>());
     }
 }
 
-
+// Generate vertices using forward-differences technique, adding them to vertices.
+template<class Coord>
+inline void generate_fd_vertices(
+    vector<Coord> &vertices,
+    const TVector &vx,
+    const TVector &vy,
+    const TVector &vz,
+    const TMatrix &m,
+    const ForwardDifferenceStep &step = ForwardDifferenceStep())
+{
+    generate_fd_vertices(
+        vertices,
+        delta_vector(vx * m, step),
+        delta_vector(vy * m, step),
+        delta_vector(vz * m, step),
+        step.steps());
+}
@@ -3,12 +3,15 @@
 #include "surfaces.h"
 #include "spline_curve.h"
 
-// Generate the vertices to represent a surface using forward-differences.
+// Generate the vertices to represent a surface using forward-differences in step, each curve drawn as a chain of
+// lines ending in ends.
 template<class Coord>
 inline void generate_fd_surface_vertices(
-    list<shared_ptr<Coord>> &vertices,
+    vector<Coord> &vertices,
+    vector<size_t> &ends,
     const TMatrix &curve_matrix,
-    const vector<Coord> &controls)
+    const vector<Coord> &controls,
+    const ForwardDifferenceStep &step = ForwardDifferenceStep())
 {
     static_assert(is_convertible<TVector, Coord>::value, "Coord must have constructor: Coord(const TVector &)");
 
@@ -17,19 +20,15 @@ inline void generate_fd_surface_vertices(
     const TMatrix cx = surface_matrix(curve_matrix, controls, 0);
     const TMatrix cy = surface_matrix(curve_matrix, controls, 1);
     const TMatrix cz = surface_matrix(curve_matrix, controls, 2);
-    const TMatrix ddx = delta_matrix(cx), ddy = delta_matrix(cy), ddz = delta_matrix(cz);
-
-    const double min = 0, max = 1;
+    const TMatrix ddx = delta_matrix(cx, step), ddy = delta_matrix(cy, step), ddz = delta_matrix(cz, step);
 
     TMatrix sddx = ddx, sddy = ddy, sddz = ddz;
-    for (double s = min; s < max || equals(s, max); s += fd_step)
+    for (size_t s = 0; s <= step.steps(); s++)
     {
         TVector dx = sddx.column(0), dy = sddy.column(0), dz = sddz.column(0);
 
-        generate_fd_vertices(vertices, dx, dy, dz);
-
-        // Not drawing lines between curves.
-        vertices.push_back(nullptr);
+        generate_fd_vertices(vertices, dx, dy, dz, step.steps());
+        ends.push_back(vertices.size());
 
         next_s_delta(sddx);
         next_s_delta(sddy);
@@ -37,14 +36,12 @@ inline void generate_fd_surface_vertices(
     }
 
     TMatrix tddx = ddx, tddy = ddy, tddz = ddz;
-    for (double t = min; t < max || equals(t, max); t += fd_step)
+    for (size_t t = 0; t <= step.steps(); t++)
     {
         TVector dx = tddx.row(0), dy = tddy.row(0), dz = tddz.row(0);
 
-        generate_fd_vertices(vertices, dx, dy, dz);
-
-        // Not drawing lines between curves.
-        vertices.push_back(nullptr);
+        generate_fd_vertices(vertices, dx, dy, dz, step.steps());
+        ends.push_back(vertices.size());
 
         next_t_delta(tddx);
         next_t_delta(tddy);
@@ -52,22 +49,32 @@ inline void generate_fd_surface_vertices(
     }
 }
 
-// Generate the vertices to represent a surface.
+// Generate the vertices to represent a surface, its patches in parallel when there are many.
 template<class Coord>
-inline list<shared_ptr<Coord>> fd_surface_vertices(const TMatrix &curve_matrix, const vector<vector<Coord>> &controls)
+inline list<shared_ptr<Coord>> fd_surface_vertices(const TMatrix &curve_matrix, const vector<vector<Coord>> &controls,
+                                                   const ForwardDifferenceStep &step = ForwardDifferenceStep())
 {
-    static_assert(is_convertible<TVector, Coord>::value, "Coord must have constructor: Coord(const TVector &)");
+    vector<Coord> coords;
+    vector<size_t> ends;
+
+    generate_patches(coords, ends, controls.size(),
+                     [&curve_matrix, &controls, &step](size_t patch, vector<Coord> &vertices, vector<size_t> &patch_ends)
+    {
+        generate_fd_surface_vertices(vertices, patch_ends, curve_matrix, controls[patch], step);
+    });
 
     list<shared_ptr<Coord>> vertices;
 
-    for (auto &c: controls)
+    size_t first = 0;
+    for (auto end: ends)
     {
-        generate_fd_surface_vertices(vertices, curve_matrix, c);
+        for (size_t i = first; i < end; i++) vertices.push_back(make_shared<Coord>(coords[i]));
+
+        // Not drawing lines between curves.
+        vertices.push_back(nullptr);
+
+        first = end;
     }
 
     return vertices;
 }
-
-
-
-
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "transforms.h"
+#include "bounding_box.h"
 
 #include <sstream>
 
@@ -31,6 +31,20 @@ const Color GREEN = Color(0, 1, 0);
 const Color BLUE = Color(0, 0, 1);
 const Color CONTROL = Color(1, 0, 1);
 
+// Records the screen-space output of a canvas
+class ScreenRecorder;
+
+// Volume of the world seen through a canvas
+class ViewVolume;
+
+// Area in world that may be clipped
+class ClippingArea;
+
+// Visible area on a canvas
+class Viewport;
+
+enum class Visibility { FULL, PARTIAL, NONE };
+
 // Drawable area of the screen
 template<class Coord>
 class Canvas
@@ -49,6 +63,72 @@ public:
     // Set the color to be used when drawing.
     virtual void set_color(const Color &color) = 0;
 
+    // Draw lines through vertices, starting from initial unless nullptr; a nullptr vertex breaks the sequence.
+    virtual void draw_polyline(const shared_ptr<Coord> &initial, const list<shared_ptr<Coord>> &vertices)
+    {
+        shared_ptr<Coord> previous = initial;
+        for (auto &current: vertices)
+        {
+            if (previous != nullptr)
+            {
+                move(*previous);
+
+                if (current != nullptr)
+                {
+                    draw_line(*current);
+                }
+            }
+
+            previous = current;
+        }
+    }
+
+    // Draw the chains of lines through contiguous vertices, ends holding the index one past the last vertex of each.
+    virtual void draw_polyline(const vector<Coord> &vertices, const vector<size_t> &ends)
+    {
+        size_t first = 0;
+        for (auto end: ends)
+        {
+            for (size_t i = first + 1; i < end; i++)
+            {
+                move(vertices[i - 1]);
+                draw_line(vertices[i]);
+            }
+
+            first = end;
+        }
+    }
+
+    // Recorder of the screen-space output of this canvas; nullptr if the output cannot be recorded.
+    virtual ScreenRecorder * screen_recorder()
+    {
+        return nullptr;
+    }
+
+    // Volume seen through this canvas; nullptr if objects cannot be culled against it.
+    virtual ViewVolume * view_volume()
+    {
+        return nullptr;
+    }
+
+    // Area of the world clipped by this canvas; nullptr if lines drawn on it are not clipped.
+    virtual ClippingArea * clipping_area()
+    {
+        return nullptr;
+    }
+
+    // Pixels covered by this canvas; nullptr if not drawn on the screen.
+    virtual Viewport * viewport()
+    {
+        return nullptr;
+    }
+
+    // World length covered by a pixel of this canvas; 0 if not known.
+    virtual double pixel_size() const
+    {
+        return 0;
+    }
+
 };
 
 // Drawable objects
@@ -89,9 +169,55 @@ public:
         return ss.str();
     }
 
+    // Version of the object's geometry; changes whenever the object is transformed.
+    unsigned long version() const
+    {
+        return _version;
+    }
+
+    // Transform according to matrix, changing the version.
+    void transform(TMatrix matrix) override
+    {
+        Transformable<Coord>::transform(matrix);
+        changed();
+    }
+
+    // Bring the object up to date with work done for it in the background, changing its version if that changes what
+    // is drawn; called before its recorded output is checked.
+    virtual void update()
+    {
+    }
+
+    // Box bounding all controls; recomputed only after the object is transformed.
+    // Curves and surfaces lie inside the convex hull of their controls, so the box bounds them as well.
+    const BoundingBox & bounding_box()
+    {
+        if (!_bounding_box_valid || _bounding_box_version != _version)
+        {
+            _bounding_box = BoundingBox(this->controls());
+            _bounding_box_version = _version;
+            _bounding_box_valid = true;
+        }
+
+        return _bounding_box;
+    }
+
+protected:
+
+    // Mark the object's geometry as changed.
+    void changed()
+    {
+        _version++;
+    }
+
 private:
 
     int _id;
+    unsigned long _version = 0;
+
+    BoundingBox _bounding_box;
+    unsigned long _bounding_box_version = 0;
+    bool _bounding_box_valid = false;
 
     static int _count;
 
@@ -291,6 +417,139 @@ private:
 
 };
 
+// Vertices of a curve or surface computed from its controls, kept in one contiguous buffer as one or more chains of lines.
+template<class Coord>
+struct Tessellation
+{
+    // Vertices of all chains, one after the other
+    vector<Coord> vertices;
+
+    // Index in vertices one past the last vertex of each chain
+    vector<size_t> ends;
+
+    // Replace the chains with the ones in coords, where a nullptr vertex breaks the sequence.
+    void assign(const list<shared_ptr<Coord>> &coords)
+    {
+        vertices.clear();
+        ends.clear();
+
+        for (auto &coord: coords)
+        {
+            if (coord != nullptr)
+            {
+                vertices.push_back(*coord);
+            }
+            else if (ends.empty() ? !vertices.empty() : ends.back() != vertices.size())
+            {
+                ends.push_back(vertices.size());
+            }
+        }
+
+        if (ends.empty() ? !vertices.empty() : ends.back() != vertices.size()) ends.push_back(vertices.size());
+    }
+
+    // Chains as a list of vertices broken by nullptr ones
+    list<shared_ptr<Coord>> coords() const
+    {
+        list<shared_ptr<Coord>> result;
+
+        size_t first = 0;
+        for (auto end: ends)
+        {
+            if (!result.empty()) result.push_back(nullptr);
+            for (size_t i = first; i < end; i++) result.push_back(make_shared<Coord>(vertices[i]));
+            first = end;
+        }
+
+        return result;
+    }
+};
+
+// Tessellation kept between frames, generated again only when the version of the controls, the method or the tolerance
+// it was generated with change.
+template<class Coord>
+class TessellationCache
+{
+public:
+
+    // Tessellation for version, method and tolerance, calling generate(tessellation) to fill it in if they changed.
+    template<typename Generate>
+    const Tessellation<Coord> & get(unsigned long version, unsigned long method, double tolerance, Generate generate)
+    {
+        if (!_valid || _version != version || _method != method || _tolerance != tolerance)
+        {
+            generate(_tessellation);
+            _version = version;
+            _method = method;
+            _tolerance = tolerance;
+            _valid = true;
+        }
+
+        return _tessellation;
+    }
+
+private:
+
+    Tessellation<Coord> _tessellation;
+    unsigned long _version = 0, _method = 0;
+    double _tolerance = 0;
+    bool _valid = false;
+
+};
+
+// Largest distance, in pixels, between adaptive curves and surfaces and the lines drawn for them
+constexpr double curve_tolerance = 0.5;
+
+// Pixel size rounded down to a power of two, so that cached tessellations are kept while zooming across the level.
+inline double pixel_size_level(double pixel_size)
+{
+    return exp2(floor(log2(pixel_size)));
+}
+
+// Curve or surface drawn in a number of steps along each of its curves that can be set for each object.
+// Adaptive methods take the ratio to the default number of steps as detail, dividing their tolerance by it.
+class Tessellated
+{
+public:
+
+    // Largest number of steps that can be set
+    constexpr static size_t max_steps = 1024;
+
+    // Number of steps along each curve
+    size_t steps() const
+    {
+        return _steps;
+    }
+
+    // Set the number of steps along each curve, between 1 and max_steps.
+    void set_steps(size_t steps)
+    {
+        steps = min(size_t(max_steps), max(size_t(1), steps));
+        if (steps == _steps) return;
+
+        _steps = steps;
+        steps_changed();
+    }
+
+    // Ratio of the number of steps to the default one
+    double detail() const
+    {
+        return double(_steps) / double(_default_steps);
+    }
+
+protected:
+
+    Tessellated(size_t default_steps): _steps(default_steps), _default_steps(default_steps) {}
+
+    // Called after the number of steps changes, so that the object is drawn again with them.
+    virtual void steps_changed() = 0;
+
+private:
+
+    size_t _steps, _default_steps;
+
+};
+
 // Sequence of lines drawn from the given vertices.
 template<class Coord>
 class Polyline: public virtual Drawable<Coord>
@@ -300,6 +559,13 @@ public:
     // Vertices to use when drawing the lines.
     virtual list<shared_ptr<Coord>> vertices() const = 0;
 
+    // Cached vertices for pixels of the given world length, or 0 if unknown,
+    // drawn and clipped in place of vertices() when not nullptr.
+    virtual const Tessellation<Coord> * tessellation(double) const
+    {
+        return nullptr;
+    }
+
     // Initial vertex of the first line to be drawn
     // nullptr if should start from first vertex in the list of vertices
     virtual shared_ptr<Coord> initial_vertex() const
@@ -310,20 +576,15 @@ public:
     // Draw the sequence of lines in canvas.
     void draw(Canvas<Coord> &canvas) override
     {
-        shared_ptr<Coord> previous = initial_vertex();
-        for (auto current: vertices())
-        {
-            if (previous != nullptr)
-            {
-                canvas.move(*previous);
+        const Tessellation<Coord> *cached = tessellation(canvas.pixel_size());
 
-                if (current != nullptr)
-                {
-                    canvas.draw_line(*current);
-                }
-            }
-
-            previous = current;
+        if (cached != nullptr)
+        {
+            canvas.draw_polyline(cached->vertices, cached->ends);
+        }
+        else
+        {
+            canvas.draw_polyline(initial_vertex(), vertices());
         }
     }
 
@@ -3,6 +3,9 @@
 #include "region.h"
 #include "clipping_cs.h"
 #include "clipping_lb.h"
+#include "clipping_sh.h"
+#include "clipping_wa.h"
+#include "clipping_batch.h"
 #include "bezier_curve.h"
 #include "spline_curve.h"
 #include "graphics.h"
@@ -53,8 +56,6 @@ public:
 
 };
 
-enum class Visibility { FULL, PARTIAL, NONE };
-
 // Area in world that may be clipped
 class ClippingArea
 {
@@ -69,6 +70,12 @@ public:
     // Translate coord from Window to World.
     virtual Coord2D window_to_world(PPC coord) const = 0;
 
+    // World length covered by a pixel where the area is shown; 0 if not known.
+    virtual double pixel_size() const
+    {
+        return 0;
+    }
+
 };
 
 // Clippable objects
@@ -82,10 +89,30 @@ public:
 
 };
 
-enum class ClippingMethod { COHEN_SUTHERLAND, LIANG_BARSKY, NONE };
+enum class ClippingMethod { COHEN_SUTHERLAND, LIANG_BARSKY, GUARD_BAND, NONE };
 
 static ClippingMethod clipping_method = ClippingMethod::COHEN_SUTHERLAND;
 
+// Half size, in Window coords, of the band around the window where lines are left for the canvas to clip
+// when clipping with the guard band; lines leaving the band are clipped to the window.
+// Kept in a function, so that every translation unit shares a single value.
+inline double & guard_band()
+{
+    static double band = 8;
+    return band;
+}
+
+// True if Window coord is in the guard band.
+inline bool in_guard_band(const PPC &coord)
+{
+    const double band = guard_band();
+    return fabs(coord.x()) <= band && fabs(coord.y()) <= band;
+}
+
+enum class PolygonClippingMethod { SUTHERLAND_HODGMAN, WEILER_ATHERTON };
+
+static PolygonClippingMethod polygon_clipping_method = PolygonClippingMethod::SUTHERLAND_HODGMAN;
+
 // Clip line between Window coord a and b.
 inline pair<PPC, PPC> clip_line(const PPC &a, const PPC &b)
 {
@@ -93,12 +120,14 @@ inline pair<PPC, PPC> clip_line(const PPC &a, const PPC &b)
     {
         case ClippingMethod::COHEN_SUTHERLAND: return clip_line_using_cs(a, b);
         case ClippingMethod::LIANG_BARSKY: return clip_line_using_lb(a, b);
+        case ClippingMethod::GUARD_BAND: return clip_line_using_lb(a, b);
         case ClippingMethod::NONE: return make_pair(a, b);
     }
 }
 
 // Clip line between World coord a and b into the area.
-inline pair<Coord2D, Coord2D> clip_line(ClippingArea &area, const Coord2D &a, const Coord2D &b)
+template<class Area>
+pair<Coord2D, Coord2D> clip_line(Area &area, const Coord2D &a, const Coord2D &b)
 {
     const PPC window_a = area.world_to_window(a);
     const PPC window_b = area.world_to_window(b);
@@ -111,36 +140,55 @@ inline pair<Coord2D, Coord2D> clip_line(ClippingArea &area, const Coord2D &a, co
     );
 }
 
-// Determine the visibility in area for line between a and b.
-inline Visibility visibility(ClippingArea &area, const Coord2D &a, const Coord2D &b)
+// True if Window coord is in the window, where left-bottom is (-1, -1) and right-top is (1, 1).
+inline bool in_window(const PPC &coord)
 {
-    static_assert(is_convertible<TVector, Coord2D>::value, "Coord2D must have constructor: Coord2D(const TVector &)");
-    static_assert(is_convertible<Coord2D, TVector>::value, "Coord2D must have conversion operator: operator TVector() const");
+    const double x = coord.x(), y = coord.y();
+    return ((x > PPC::norm_left && x < PPC::norm_right) || equals(x, PPC::norm_left) || equals(x, PPC::norm_right)) &&
+           ((y > PPC::norm_bottom && y < PPC::norm_top) || equals(y, PPC::norm_bottom) || equals(y, PPC::norm_top));
+}
 
+// Determine the visibility in the window for line between Window coord a and b.
+inline Visibility visibility(const PPC &a, const PPC &b)
+{
     if (clipping_method == ClippingMethod::NONE) return Visibility::FULL;
 
-    const bool a_in_area = area.contains(a);
-    const bool b_in_area = area.contains(b);
+    if (clipping_method == ClippingMethod::GUARD_BAND && in_guard_band(a) && in_guard_band(b))
+        return in_one_super_region(a, b) ? Visibility::NONE : Visibility::FULL;
+
+    const bool a_in_window = in_window(a);
+    const bool b_in_window = in_window(b);
 
-    if (a_in_area && b_in_area)
+    if (a_in_window && b_in_window)
     {
         return Visibility::FULL;
     }
-    else if (a_in_area || b_in_area || area.contains(equidistant(a, b)))
+    else if (a_in_window || b_in_window || in_window(PPC((a.x() + b.x()) / 2, (a.y() + b.y()) / 2)))
     {
         return Visibility::PARTIAL;
     }
-    else if (in_one_super_region(area.world_to_window(a), area.world_to_window(b)))
+    else if (in_one_super_region(a, b))
     {
         return Visibility::NONE;
     }
     else
     {
-        const pair<Coord2D, Coord2D> clipped = clip_line(area, a, b);
-        return area.contains(clipped.first) || area.contains(clipped.second) ? Visibility::PARTIAL : Visibility::NONE;
+        const pair<PPC, PPC> clipped = clip_line(a, b);
+        return in_window(clipped.first) || in_window(clipped.second) ? Visibility::PARTIAL : Visibility::NONE;
     }
 }
 
+// Determine the visibility in area for line between a and b.
+// Area is a template parameter so that its translations are resolved at compile time when its type is known.
+template<class Area>
+Visibility visibility(Area &area, const Coord2D &a, const Coord2D &b)
+{
+    static_assert(is_convertible<TVector, Coord2D>::value, "Coord2D must have constructor: Coord2D(const TVector &)");
+    static_assert(is_convertible<Coord2D, TVector>::value, "Coord2D must have conversion operator: operator TVector() const");
+
+    return visibility(area.world_to_window(a), area.world_to_window(b));
+}
+
 // 2D drawable objects
 class Drawable2D: public virtual Drawable<Coord2D>
 {
@@ -252,6 +300,30 @@ private:
 
 };
 
+// Vertices left by clipping a polyline, as one or more chains of lines, with the scratch space of the clippers.
+// Kept by the caller between frames, so that clipping does not allocate.
+struct ClippingBuffer
+{
+    // World coords of the vertices of all chains, one after the other
+    vector<Coord2D> vertices;
+
+    // Index in vertices one past the last vertex of each chain
+    vector<size_t> ends;
+
+    // Window coords of polygons being clipped
+    vector<PPC> window, scratch;
+    vector<size_t> window_ends;
+    WeilerAthertonClipper<PPC> weiler_atherton;
+
+    // Vertices of polylines being clipped with their window coords, the visibility of each line between them,
+    // and the lines crossing the window sides, with the index of each, clipped in a batch
+    vector<const Coord2D *> points;
+    vector<PPC> window_points;
+    vector<Visibility> lines;
+    SegmentBatch crossing, crossed;
+    vector<size_t> crossing_lines, crossed_sources;
+};
+
 // Sequence of lines drawn from the given vertices.
 class Polyline2D: public virtual Drawable2D, public Polyline<Coord2D>, public Clippable<Drawable2D>
 {
@@ -262,12 +334,83 @@ public:
 
     // Determine the visibility in area.
     Visibility visibility_in(ClippingArea &area) const override
+    {
+        const Tessellation<Coord2D> *cached = tessellation(area.pixel_size());
+
+        return cached != nullptr ?
+            visibility_of(area, nullptr, cached->vertices) :
+            visibility_of(area, initial_vertex().get(), vertices());
+    }
+
+    // Provide clipped version of itself in area.
+    // Chains after the first one are kept apart by nullptr vertices, each closed by its first vertex if closed().
+    shared_ptr<Drawable2D> clipped_in(ClippingArea &area) override;
+
+    // True if the lines of the clipped drawable go back from its last vertex to its first one.
+    virtual bool closed() const
+    {
+        return false;
+    }
+
+    // Determine the visibility in area and replace clipped with the vertices of the clipped version in the same pass,
+    // classifying each line once; the lines left make up a single chain.
+    virtual Visibility clip_into(ClippingArea &area, ClippingBuffer &buffer) const
+    {
+        const Tessellation<Coord2D> *cached = tessellation(area.pixel_size());
+
+        return cached != nullptr ?
+            clip_vertices_into(area, buffer, nullptr, cached->vertices) :
+            clip_vertices_into(area, buffer, initial_vertex().get(), vertices());
+    }
+
+    // Draw the chains of lines clipped by clip_into() in canvas, as the clipped drawable would.
+    void draw_clipped(Canvas<Coord2D> &canvas, const ClippingBuffer &clipped) const
+    {
+        size_t first = 0;
+        for (auto end: clipped.ends)
+        {
+            const Coord2D *previous = closed() ? &clipped.vertices[end - 1] : nullptr;
+            for (size_t i = first; i < end; i++)
+            {
+                const Coord2D &current = clipped.vertices[i];
+
+                if (previous != nullptr)
+                {
+                    canvas.move(*previous);
+                    canvas.draw_line(current);
+                }
+
+                previous = &current;
+            }
+
+            first = end;
+        }
+    }
+
+private:
+
+    // Address of a vertex, whether held by a shared pointer or in place
+    static const Coord2D * address(const shared_ptr<Coord2D> &vertex)
+    {
+        return vertex.get();
+    }
+
+    static const Coord2D * address(const Coord2D &vertex)
+    {
+        return &vertex;
+    }
+
+    // Determine the visibility in area of the lines through vertices, starting from initial unless nullptr.
+    template<class Vertices>
+    static Visibility visibility_of(ClippingArea &area, const Coord2D *initial, const Vertices &vertices)
     {
         Visibility result = Visibility::NONE;
 
-        shared_ptr<Coord2D> previous = initial_vertex();
-        for (auto current: vertices())
+        const Coord2D *previous = initial;
+        for (auto &vertex: vertices)
         {
+            const Coord2D *current = address(vertex);
+
             if (previous != nullptr)
             {
                 const Visibility v = visibility(area, *previous, *current);
@@ -287,66 +430,133 @@ public:
         return result;
     }
 
-    // Provide clipped version of itself in area.
-    shared_ptr<Drawable2D> clipped_in(ClippingArea &area) override
+    // Clip the lines through vertices, starting from initial unless nullptr, into buffer as clip_into() does.
+    // Lines are classified first; those crossing the window sides are then clipped together by the batch clipper,
+    // in window coords with w = 1, before the chain is made of the lines left in order.
+    template<class Vertices>
+    static Visibility clip_vertices_into(ClippingArea &area, ClippingBuffer &buffer, const Coord2D *initial,
+                                         const Vertices &vertices)
     {
-        list<shared_ptr<Coord2D>> new_vertices;
+        vector<Coord2D> &clipped = buffer.vertices;
+        clipped.clear();
+        buffer.ends.clear();
+
+        vector<const Coord2D *> &points = buffer.points;
+        vector<PPC> &window = buffer.window_points;
+        points.clear();
+        window.clear();
 
-        shared_ptr<Coord2D> previous = initial_vertex();
-        for (auto current: vertices())
+        if (initial != nullptr)
         {
-            if (previous != nullptr)
+            points.push_back(initial);
+            window.push_back(area.world_to_window(*initial));
+        }
+
+        for (auto &vertex: vertices)
+        {
+            points.push_back(address(vertex));
+            window.push_back(area.world_to_window(*points.back()));
+        }
+
+        buffer.lines.clear();
+        buffer.crossing.clear();
+        buffer.crossing_lines.clear();
+
+        for (size_t i = 1; i < points.size(); i++)
+        {
+            const PPC &a = window[i - 1], &b = window[i];
+            buffer.lines.push_back(classify(a, b));
+
+            if (buffer.lines.back() != Visibility::PARTIAL) continue;
+
+            buffer.crossing.add({ a.x(), a.y(), 1 }, { b.x(), b.y(), 1 });
+            buffer.crossing_lines.push_back(i - 1);
+        }
+
+        buffer.crossed.clear();
+        buffer.crossed_sources.clear();
+        buffer.crossing.clip(CLIP_LEFT | CLIP_RIGHT | CLIP_BOTTOM | CLIP_TOP, buffer.crossed, 1, &buffer.crossed_sources);
+
+        // Vertex of the original lines added last to clipped; nullptr if it was a clipped one.
+        const Coord2D *last_added = nullptr;
+
+        auto add_original = [&clipped, &last_added](const Coord2D *vertex)
+        {
+            if (clipped.empty() || last_added != vertex) clipped.push_back(*vertex);
+            last_added = vertex;
+        };
+
+        auto add_clipped = [&area, &clipped, &last_added](const Coord2D &vertex)
+        {
+            if (area.contains(vertex) && (clipped.empty() || clipped.back() != vertex))
             {
-                switch (visibility(area, *previous, *current))
+                clipped.push_back(vertex);
+                last_added = nullptr;
+            }
+        };
+
+        bool partial = false;
+        Visibility last = Visibility::NONE;
+        size_t next_crossed = 0;
+
+        for (size_t line = 0; line < buffer.lines.size(); line++)
+        {
+            const PPC &window_a = window[line], &window_b = window[line + 1];
+            Visibility visibility = buffer.lines[line];
+
+            // Lines that may cross the window are partially visible if anything is left of them once clipped.
+            if (visibility == Visibility::PARTIAL)
+            {
+                const bool left = next_crossed < buffer.crossed.size() &&
+                                  buffer.crossing_lines[buffer.crossed_sources[next_crossed]] == line;
+
+                if (left)
                 {
-                    case Visibility::FULL:
-                    {
-                        if (new_vertices.back() != previous)
-                            new_vertices.push_back(previous);
-                        if (new_vertices.back() != current)
-                            new_vertices.push_back(current);
-                    }
-                        break;
-
-                    case Visibility::PARTIAL:
-                    {
-                        const pair<Coord2D, Coord2D> clipped_line = clip_line(area, *previous, *current);
-
-                        if (area.contains(clipped_line.first) && (new_vertices.back() == nullptr || *new_vertices.back() != clipped_line.first))
-                        {
-                            new_vertices.push_back(make_shared<Coord2D>(clipped_line.first));
-                        }
-
-                        if (area.contains(clipped_line.second) && (new_vertices.back() == nullptr || *new_vertices.back() != clipped_line.second))
-                        {
-                            new_vertices.push_back(make_shared<Coord2D>(clipped_line.second));
-                        }
-                    }
-                    break;
-
-                    case Visibility::NONE:
-                    {
-                        const PPC window_a = area.world_to_window(*previous);
-                        const PPC window_b = area.world_to_window(*current);
-
-                        if (region(window_a) != region(window_b))
-                        {
-                            // Determine closest corner
-                            const double x = min(window_a.x(), window_b.x()) < PPC::norm_left ? PPC::norm_left : PPC::norm_right;
-                            const double y = min(window_a.y(), window_b.y()) < PPC::norm_bottom ? PPC::norm_bottom : PPC::norm_top;
-                            const Coord2D corner = area.window_to_world(PPC(x, y));
-
-                            if (area.contains(corner) && (new_vertices.back() == nullptr || *new_vertices.back() != corner))
-                                new_vertices.push_back(make_shared<Coord2D>(corner));
-                        }
-                    }
+                    const ClipPoint a = buffer.crossed.a(next_crossed), b = buffer.crossed.b(next_crossed);
+                    add_clipped(area.window_to_world(PPC(a.x, a.y)));
+                    add_clipped(area.window_to_world(PPC(b.x, b.y)));
+                    next_crossed++;
+                }
+                else
+                {
+                    visibility = Visibility::NONE;
                 }
             }
 
-            previous = current;
+            if (visibility == Visibility::FULL)
+            {
+                add_original(points[line]);
+                add_original(points[line + 1]);
+            }
+            else if (visibility == Visibility::NONE && region(window_a) != region(window_b))
+            {
+                // Determine closest corner
+                const double x = min(window_a.x(), window_b.x()) < PPC::norm_left ? PPC::norm_left : PPC::norm_right;
+                const double y = min(window_a.y(), window_b.y()) < PPC::norm_bottom ? PPC::norm_bottom : PPC::norm_top;
+
+                add_clipped(area.window_to_world(PPC(x, y)));
+            }
+
+            if (visibility == Visibility::PARTIAL) partial = true; else last = visibility;
         }
 
-        return clipped_drawable(new_vertices);
+        if (!clipped.empty()) buffer.ends.push_back(clipped.size());
+
+        return partial ? Visibility::PARTIAL : last;
+    }
+
+    // Classify line between Window coord a and b as visibility() does, without clipping it: lines that may cross
+    // the window sides are partially visible, to be confirmed by clipping them.
+    static Visibility classify(const PPC &a, const PPC &b)
+    {
+        if (clipping_method == ClippingMethod::NONE) return Visibility::FULL;
+
+        if (clipping_method == ClippingMethod::GUARD_BAND && in_guard_band(a) && in_guard_band(b))
+            return in_one_super_region(a, b) ? Visibility::NONE : Visibility::FULL;
+
+        if (in_window(a) && in_window(b)) return Visibility::FULL;
+
+        return in_one_super_region(a, b) ? Visibility::NONE : Visibility::PARTIAL;
     }
 
 };
@@ -388,6 +598,63 @@ public:
         return make_shared<Polygon>(clipped_vertices);
     }
 
+    // Polygons are closed.
+    bool closed() const override
+    {
+        return true;
+    }
+
+    // Clip the polygon as an area, with polygon_clipping_method, rather than line by line.
+    Visibility clip_into(ClippingArea &area, ClippingBuffer &buffer) const override
+    {
+        buffer.vertices.clear();
+        buffer.ends.clear();
+
+        if (clipping_method == ClippingMethod::NONE) return Visibility::FULL;
+
+        // A polygon all in the window is drawn as it is. Otherwise, one all outside one side of the window leaves nothing,
+        // and one all in the guard band is left for the canvas to clip.
+        bool in_window_only = true, in_band_only = true;
+        RegionCode common_code = NORTH | SOUTH | EAST | WEST;
+
+        buffer.window.clear();
+        for (auto &vertex: _vertices)
+        {
+            const PPC window = area.world_to_window(*vertex);
+            buffer.window.push_back(window);
+
+            in_window_only = in_window_only && in_window(window);
+            in_band_only = in_band_only && in_guard_band(window);
+            common_code &= region_code(window);
+        }
+
+        if (in_window_only) return Visibility::FULL;
+        if (common_code != 0) return Visibility::NONE;
+        if (in_band_only && clipping_method == ClippingMethod::GUARD_BAND) return Visibility::FULL;
+
+        switch (polygon_clipping_method)
+        {
+            case PolygonClippingMethod::SUTHERLAND_HODGMAN:
+            {
+                clip_polygon_using_sh(buffer.window, buffer.scratch);
+                buffer.window_ends.assign(buffer.window.empty() ? 0 : 1, buffer.window.size());
+            }
+            break;
+
+            case PolygonClippingMethod::WEILER_ATHERTON:
+            {
+                buffer.weiler_atherton.clip(buffer.window, buffer.scratch, buffer.window_ends);
+                buffer.window.swap(buffer.scratch);
+            }
+            break;
+        }
+
+        for (auto &vertex: buffer.window) buffer.vertices.push_back(area.window_to_world(vertex));
+        buffer.ends = buffer.window_ends;
+
+        return buffer.vertices.empty() ? Visibility::NONE : Visibility::PARTIAL;
+    }
+
     list<Coord2D *> controls() override
     {
         list<Coord2D *> vertices;
@@ -428,13 +695,52 @@ private:
 
 };
 
+// Provide clipped version of the polyline in area.
+inline shared_ptr<Drawable2D> Polyline2D::clipped_in(ClippingArea &area)
+{
+    ClippingBuffer clipped;
+    if (clip_into(area, clipped) == Visibility::FULL) return clipped_drawable(vertices());
+
+    list<shared_ptr<Coord2D>> new_vertices;
+    if (clipped.ends.size() == 1)
+    {
+        for (auto &vertex: clipped.vertices) new_vertices.push_back(make_shared<Coord2D>(vertex));
+        return clipped_drawable(new_vertices);
+    }
+
+    size_t first = 0;
+    for (auto end: clipped.ends)
+    {
+        if (!new_vertices.empty()) new_vertices.push_back(nullptr);
+
+        for (size_t i = first; i < end; i++) new_vertices.push_back(make_shared<Coord2D>(clipped.vertices[i]));
+        if (closed()) new_vertices.push_back(make_shared<Coord2D>(clipped.vertices[first]));
+
+        first = end;
+    }
+
+    return make_shared<ClippedPolyline>(new_vertices);
+}
+
+enum class CurveMethod { FIXED_STEP, ADAPTIVE };
+
+static CurveMethod curve_method = CurveMethod::ADAPTIVE;
+
+// World distance within which curves are drawn for pixels of pixel_size world length; 0 to draw them with fixed steps.
+inline double curve_world_tolerance(double pixel_size)
+{
+    if (curve_method == CurveMethod::FIXED_STEP || pixel_size <= 0) return 0;
+
+    return curve_tolerance * pixel_size_level(pixel_size);
+}
+
 // Curve defined by two edge coords and two internal control points
-class BezierCurve: public Object2D, public Polyline2D
+class BezierCurve: public Object2D, public Polyline2D, public Tessellated
 {
 public:
 
     BezierCurve(Coord2D edge1, Coord2D control1, Coord2D edge2, Coord2D control2)
-        : _edge1(edge1), _control1(control1), _edge2(edge2), _control2(control2) {}
+        : Tessellated(bezier_steps), _edge1(edge1), _control1(control1), _edge2(edge2), _control2(control2) {}
 
     // Type used in the name
     string type() const override
@@ -451,7 +757,29 @@ public:
     // Vertices to use when drawing the lines.
     list<shared_ptr<Coord2D>> vertices() const override
     {
-        return bezier_curve_vertices(_edge1, _control1, _control2, _edge2);
+        return bezier_curve_vertices(_edge1, _control1, _control2, _edge2, steps());
+    }
+
+    // Vertices cached until the curve is transformed, its steps or its tolerance change,
+    // subdivided within the tolerance for pixels of pixel_size world length unless drawn with fixed steps
+    const Tessellation<Coord2D> * tessellation(double pixel_size) const override
+    {
+        const double tolerance = curve_world_tolerance(pixel_size) / detail();
+
+        return &_tessellation.get(version(), (unsigned long) curve_method, tolerance,
+                                  [this, tolerance](Tessellation<Coord2D> &tessellation)
+        {
+            if (tolerance == 0)
+            {
+                tessellation.assign(vertices());
+            }
+            else
+            {
+                tessellation.vertices.clear();
+                adaptive_bezier_curve_vertices(tessellation.vertices, _edge1, _control1, _control2, _edge2, tolerance);
+                tessellation.ends.assign(1, tessellation.vertices.size());
+            }
+        });
     }
 
     // New drawable from clipped_vertices
@@ -465,19 +793,29 @@ public:
         return { &_edge1, &_control1, &_edge2, &_control2 };
     }
 
+protected:
+
+    // Draw again with the new steps.
+    void steps_changed() override
+    {
+        changed();
+    }
+
 private:
 
     Coord2D _edge1, _control1;
     Coord2D _edge2, _control2;
 
+    mutable TessellationCache<Coord2D> _tessellation;
+
 };
 
 // B-Spline curve defined by a list of control coords.
-class SplineCurve: public Object2D, public Polyline2D
+class SplineCurve: public Object2D, public Polyline2D, public Tessellated
 {
 public:
 
-    SplineCurve(vector<Coord2D> controls): _controls(controls) {}
+    SplineCurve(vector<Coord2D> controls): Tessellated(fd_steps), _controls(controls) {}
 
     // Type used in the name
     string type() const override
@@ -488,7 +826,31 @@ public:
     // Vertices to use when drawing the lines
     list<shared_ptr<Coord2D>> vertices() const override
     {
-        return spline_curve_vertices(_controls);
+        return spline_curve_vertices(_controls, _fd_step);
+    }
+
+    // Vertices cached until the curve is transformed, its steps or its tolerance change,
+    // subdivided within the tolerance for pixels of pixel_size world length unless drawn with fixed steps
+    const Tessellation<Coord2D> * tessellation(double pixel_size) const override
+    {
+        const double tolerance = curve_world_tolerance(pixel_size) / detail();
+
+        return &_tessellation.get(version(), (unsigned long) curve_method, tolerance,
+                                  [this, tolerance](Tessellation<Coord2D> &tessellation)
+        {
+            tessellation.vertices.clear();
+
+            if (tolerance == 0)
+            {
+                spline_curve_vertices(tessellation.vertices, _controls, _fd_step);
+            }
+            else
+            {
+                adaptive_spline_curve_vertices(tessellation.vertices, _controls, tolerance);
+            }
+
+            tessellation.ends.assign(1, tessellation.vertices.size());
+        });
     }
 
     // New drawable from clipped_vertices
@@ -507,9 +869,20 @@ public:
         return result;
     }
 
+protected:
+
+    // Draw again with forward differences for the new steps.
+    void steps_changed() override
+    {
+        _fd_step = ForwardDifferenceStep(steps());
+        changed();
+    }
+
 private:
 
     vector<Coord2D> _controls;
+    ForwardDifferenceStep _fd_step;
+    mutable TessellationCache<Coord2D> _tessellation;
 
 };
 
@@ -2,7 +2,14 @@
 
 #include "surfaces.h"
 #include "fd_surfaces.h"
+#include "adaptive_surfaces.h"
 #include "graphics.h"
+#include "bvh.h"
+#include "decimation.h"
+#include "rasterizer.h"
+#include "clipping_homogeneous.h"
+
+#include <unordered_map>
 
 // 3D coordinates
 class Coord3D: public XYZCoord<Coord3D>
@@ -25,6 +32,59 @@ public:
 template<>
 int Object<Coord3D>::_count = 0;
 
+// Point a fraction t of the way from a to b
+inline Coord3D between(const Coord3D &a, const Coord3D &b, double t)
+{
+    return Coord3D(a.x() + (b.x() - a.x()) * t, a.y() + (b.y() - a.y()) * t, a.z() + (b.z() - a.z()) * t);
+}
+
+// Volume of the world seen through a canvas
+class ViewVolume
+{
+public:
+
+    // Determine the visibility of box inside the volume.
+    virtual Visibility visibility(const BoundingBox &box) const = 0;
+
+    // Enable or disable clipping of the lines drawn; disabled for objects known to be fully visible.
+    virtual void set_clipping(bool clipping) = 0;
+
+    // Size in pixels of the larger side of the projection of box on the screen; infinite if unknown.
+    virtual double screen_size(const BoundingBox &box) const = 0;
+
+    // Direction from point toward the eye
+    virtual Coord3D to_eye(const Coord3D &point) const = 0;
+
+    // Homogeneous w of coord once projected; coords where it is less than near_w are behind the near plane.
+    virtual double w(const Coord3D &coord) const = 0;
+
+    // Position of coord on the screen; false if it cannot be projected or the screen is unknown.
+    virtual bool screen_point(const Coord3D &coord, ScreenPoint &point) const = 0;
+
+    // Depth buffer covering the screen, shared by all objects in the frame; nullptr if hidden lines are not removed
+    // with a depth buffer.
+    virtual DepthBuffer * depth_buffer() = 0;
+
+    // Frame buffer shared by all objects rendered solid; nullptr if not rendering solid.
+    virtual FrameBuffer * frame_buffer() = 0;
+
+    // Color objects are drawn with
+    virtual Color color() const = 0;
+
+    // Affine map taking world coords to pixel space, where x and y are clip space scaled to pixels and z is 0,
+    // if the projection is affine, so that curves and surfaces can be tessellated from their projected controls;
+    // nullptr otherwise.
+    virtual const TMatrix * pixel_map() const
+    {
+        return nullptr;
+    }
+
+    // Draw the chains of lines through contiguous vertices in pixel space, ends holding the index one past the last
+    // vertex of each.
+    virtual void draw_pixel_polyline(const vector<Coord3D> &vertices, const vector<size_t> &ends) = 0;
+
+};
+
 // 3D line segment
 class Segment3D: public Transformable<Coord3D>
 {
@@ -104,16 +164,34 @@ private:
 
 };
 
-enum class SurfaceMethod { REGULAR, FORWARD_DIFFERENCE };
+enum class SurfaceMethod { REGULAR, FORWARD_DIFFERENCE, ADAPTIVE };
+
+static SurfaceMethod surface_method = SurfaceMethod::ADAPTIVE;
+
+enum class DetailMethod { AUTOMATIC, FULL };
+
+static DetailMethod detail_method = DetailMethod::AUTOMATIC;
+
+enum class HiddenLineMethod { NONE, BACK_FACE_CULLING, DEPTH_BUFFER };
+
+static HiddenLineMethod hidden_line_method = HiddenLineMethod::NONE;
+
+enum class FillMethod { WIREFRAME, SOLID };
+
+static FillMethod fill_method = FillMethod::WIREFRAME;
 
-static SurfaceMethod surface_method = SurfaceMethod::FORWARD_DIFFERENCE;
+// Color faces are filled with when lines are drawn with color; light gray for black, which is hardly seen filled.
+inline Color fill_color(const Color &color)
+{
+    return color.red() == 0 && color.green() == 0 && color.blue() == 0 ? LIGHTER_GRAY : color;
+}
 
 // Surface defined by some type of curve
-class Surface: public Object<Coord3D>, public Polyline<Coord3D>
+class Surface: public Object<Coord3D>, public Polyline<Coord3D>, public Tessellated
 {
 public:
 
-    Surface(vector<vector<Coord3D>> controls): _controls(controls)
+    Surface(vector<vector<Coord3D>> controls): Tessellated(surface_curve_steps), _controls(controls)
     {
         for (auto &c: controls)
             assert(c.size() >= surface_geometry_matrix_size);
@@ -132,12 +210,79 @@ public:
 
     virtual TMatrix & curve() const = 0;
 
-    // Vertices to use when drawing the lines.
+    // Vertices to use when drawing the lines; forward differences stand for adaptive surfaces, which need a pixel size.
     list<shared_ptr<Coord3D>> vertices() const override
     {
         return surface_method == SurfaceMethod::REGULAR ?
-            surface_vertices(curve(), _controls) :
-            fd_surface_vertices(curve(), _controls);
+            surface_vertices(curve(), _controls, steps()) :
+            fd_surface_vertices(curve(), _controls, _fd_step);
+    }
+
+    // Vertices cached until the surface is transformed, its steps or surface_method change or, for adaptive surfaces,
+    // the pixel size crosses a level; patches are tessellated in parallel when there are many.
+    const Tessellation<Coord3D> * tessellation(double pixel_size) const override
+    {
+        const double level = surface_method == SurfaceMethod::ADAPTIVE && pixel_size > 0 ? pixel_size_level(pixel_size) : 0;
+
+        return &_tessellation.get(version(), (unsigned long) surface_method, level,
+                                  [this, level](Tessellation<Coord3D> &tessellation)
+        {
+            if (level == 0 && surface_method == SurfaceMethod::REGULAR)
+            {
+                tessellation.assign(vertices());
+                return;
+            }
+
+            tessellation.vertices.clear();
+            tessellation.ends.clear();
+
+            generate_patches(tessellation.vertices, tessellation.ends, _controls.size(),
+                             [this, level](size_t patch, vector<Coord3D> &vertices, vector<size_t> &ends)
+            {
+                if (level == 0)
+                {
+                    generate_fd_surface_vertices(vertices, ends, curve(), _controls[patch], _fd_step);
+                }
+                else
+                {
+                    generate_adaptive_surface_vertices(vertices, ends, curve(), _controls[patch],
+                                                       curve_tolerance * level / detail(),
+                                                       surface_curve_spacing * level / detail());
+                }
+            });
+        });
+    }
+
+    // Draw the lines in canvas. Under an affine projection, adaptive surfaces project their controls instead of their
+    // vertices, as the curves keep their shape under affine maps, and are tessellated within curve_tolerance pixels
+    // of their projection; surfaces drawn with fixed steps keep projecting their cached vertices, which costs less.
+    void draw(Canvas<Coord3D> &canvas) override
+    {
+        ViewVolume *view_volume = canvas.view_volume();
+        const TMatrix *map = view_volume == nullptr ? nullptr : view_volume->pixel_map();
+
+        if (map == nullptr || surface_method != SurfaceMethod::ADAPTIVE)
+        {
+            Polyline<Coord3D>::draw(canvas);
+            return;
+        }
+
+        vector<vector<Coord3D>> projected(_controls.size());
+        for (size_t patch = 0; patch < _controls.size(); patch++)
+            for (auto &control: _controls[patch])
+                projected[patch].push_back(Coord3D(TVector(control) * *map));
+
+        _projected.vertices.clear();
+        _projected.ends.clear();
+
+        generate_patches(_projected.vertices, _projected.ends, projected.size(),
+                         [this, &projected](size_t patch, vector<Coord3D> &vertices, vector<size_t> &ends)
+        {
+            generate_adaptive_surface_vertices(vertices, ends, curve(), projected[patch],
+                                               curve_tolerance / detail(), surface_curve_spacing / detail());
+        });
+
+        view_volume->draw_pixel_polyline(_projected.vertices, _projected.ends);
     }
 
     // Control coords
@@ -152,9 +297,23 @@ public:
         return vertices;
     }
 
+protected:
+
+    // Draw again with forward differences for the new steps.
+    void steps_changed() override
+    {
+        _fd_step = ForwardDifferenceStep(steps());
+        changed();
+    }
+
 private:
 
     vector<vector<Coord3D>> _controls;
+    ForwardDifferenceStep _fd_step;
+    mutable TessellationCache<Coord3D> _tessellation;
+
+    // Tessellation in pixel space of the last frame drawn under an affine projection, kept to reuse its buffers
+    Tessellation<Coord3D> _projected;
 
 };
 
@@ -217,10 +376,71 @@ public:
         return _vertices;
     }
 
+    // Box bounding all vertices
+    BoundingBox bounding_box() const
+    {
+        BoundingBox box;
+
+        for (auto &v: _vertices)
+            box.add(*v);
+
+        return box;
+    }
+
+    // Normal by Newell's method, toward the side from which the vertices are seen counter-clockwise.
+    // Computed once for each version of the vertices.
+    const Coord3D & normal(unsigned long version)
+    {
+        if (_normal_valid && _normal_version == version) return _normal;
+
+        double x = 0, y = 0, z = 0;
+        shared_ptr<Coord3D> previous = _vertices.back();
+
+        for (auto &current: _vertices)
+        {
+            const Coord3D &p = *previous, &q = *current;
+
+            x += (p.y() - q.y()) * (p.z() + q.z());
+            y += (p.z() - q.z()) * (p.x() + q.x());
+            z += (p.x() - q.x()) * (p.y() + q.y());
+
+            previous = current;
+        }
+
+        _normal = Coord3D(x, y, z);
+        _normal_version = version;
+        _normal_valid = true;
+
+        return _normal;
+    }
+
+    // Cosine of the angle between the normal and the direction to the eye, given the version of the vertices;
+    // positive if the face is seen from the front.
+    double facing(const ViewVolume &view_volume, unsigned long version)
+    {
+        const Coord3D &n = normal(version);
+        const Coord3D e = view_volume.to_eye(*_vertices.front());
+
+        const double lengths = sqrt((n.x() * n.x() + n.y() * n.y() + n.z() * n.z()) *
+                                    (e.x() * e.x() + e.y() * e.y() + e.z() * e.z()));
+
+        return lengths == 0 ? 0 : (n.x() * e.x() + n.y() * e.y() + n.z() * e.z()) / lengths;
+    }
+
+    // True if the face is seen from the front through view volume, given the version of its vertices.
+    bool front_facing(const ViewVolume &view_volume, unsigned long version)
+    {
+        return facing(view_volume, version) > 0;
+    }
+
 private:
 
     list<shared_ptr<Coord3D>> _vertices;
 
+    Coord3D _normal;
+    unsigned long _normal_version = 0;
+    bool _normal_valid = false;
+
 };
 
 // 3D groups of faces
@@ -245,12 +465,96 @@ public:
         return ss.str();
     }
 
-    // Draw the sequence of segments in canvas.
+    // Screen area, in pixels, that a face of a level of detail should cover
+    constexpr static double pixels_per_face = 16;
+
+    // Fraction of the depth range of the group within which edges are not hidden by the faces they belong to
+    constexpr static double depth_tolerance = 0.01;
+
+    // Maximum number of pieces each edge is split into when testing its visibility
+    constexpr static size_t max_edge_pieces = 4096;
+
+    using Face = LevelsOfDetail::Face;
+
+    // Draw the faces in canvas, skipping the subtrees of the hierarchy that are out of the view volume.
+    // Groups small on screen are drawn with the coarsest level of detail enough for their size.
+    // Hidden lines are removed according to the hidden line method.
     void draw(Canvas<Coord3D> &canvas) override
     {
-        for (auto &f: _faces)
+        ViewVolume *view_volume = canvas.view_volume();
+
+        if (view_volume == nullptr)
+        {
+            for (auto &f: _faces)
+            {
+                f->draw(canvas);
+            }
+
+            return;
+        }
+
+        const size_t level = level_of_detail(*view_volume);
+
+        if (fill_method == FillMethod::SOLID && view_volume->frame_buffer() != nullptr)
+        {
+            fill_faces(*view_volume, level, visible_faces(*view_volume, level));
+            return;
+        }
+
+        if (hidden_line_method == HiddenLineMethod::DEPTH_BUFFER && view_volume->depth_buffer() != nullptr)
         {
-            f->draw(canvas);
+            draw_visible_edges(canvas, *view_volume, level, visible_faces(*view_volume, level));
+            return;
+        }
+
+        const vector<shared_ptr<Face3D>> &faces = level_faces(level);
+
+        hierarchy(level).traverse(
+            [view_volume](const BoundingBox &box)
+            {
+                return view_volume->visibility(box);
+            },
+            [this, view_volume, &canvas, &faces](size_t face, Visibility visibility)
+            {
+                if (visibility == Visibility::FULL)
+                {
+                    view_volume->set_clipping(false);
+                    draw_face(canvas, *view_volume, *faces[face]);
+                    view_volume->set_clipping(true);
+                }
+                else
+                {
+                    draw_face(canvas, *view_volume, *faces[face]);
+                }
+            });
+    }
+
+    // Change the version once the levels of detail built in the background are ready, so that the output recorded
+    // with the full mesh meanwhile is recorded again with them.
+    void update() override
+    {
+        if (_levels_drawn || !_levels.ready()) return;
+
+        _levels_drawn = true;
+        changed();
+    }
+
+    // Rasterize the faces that may be seen into the depth buffer of view volume, shared by all groups in the frame,
+    // before any of them draws its visible edges.
+    void rasterize_faces(ViewVolume &view_volume)
+    {
+        DepthBuffer &depth_buffer = *view_volume.depth_buffer();
+        const size_t level = level_of_detail(view_volume);
+        const vector<Face> &indices = level_indices(level);
+        ScreenPoints points(view_volume, _vertices);
+
+        for (size_t f: visible_faces(view_volume, level))
+        {
+            const Face &face = indices[f];
+            if (!points.projected(face)) continue;
+
+            for (size_t i = 1; i + 1 < face.size(); i++)
+                depth_buffer.rasterize(points[face.front()], points[face[i]], points[face[i + 1]]);
         }
     }
 
@@ -264,10 +568,359 @@ public:
         return controls;
     }
 
+    // Coarsest level of detail enough for the size of the group on screen; 0 for the full mesh.
+    // The levels are requested on the first call and built in the background; the full mesh is used meanwhile.
+    size_t level_of_detail(const ViewVolume &view_volume)
+    {
+        if (detail_method == DetailMethod::FULL || _faces.size() < 2 * LevelsOfDetail::minimum_faces) return 0;
+
+        if (!_levels.started())
+        {
+            _levels.build(positions(), face_indices());
+            return 0;
+        }
+
+        if (!_levels.ready() || _levels.levels().empty()) return 0;
+
+        if (_level_faces.empty())
+        {
+            for (auto &level: _levels.levels())
+            {
+                _level_faces.push_back(as_faces(level));
+            }
+        }
+
+        const double size = view_volume.screen_size(bounding_box());
+        const double budget = size * size / pixels_per_face;
+
+        if (_faces.size() <= budget) return 0;
+
+        for (size_t level = 0; level < _level_faces.size(); level++)
+        {
+            if (_level_faces[level].size() <= budget) return level + 1;
+        }
+
+        return _level_faces.size();
+    }
+
 private:
 
+    // Draw face in canvas, unless culled as a back face.
+    void draw_face(Canvas<Coord3D> &canvas, const ViewVolume &view_volume, Face3D &face)
+    {
+        if (hidden_line_method == HiddenLineMethod::BACK_FACE_CULLING && !face.front_facing(view_volume, version())) return;
+
+        face.draw(canvas);
+    }
+
+    // Faces of a level of detail; level 0 is the full mesh.
+    const vector<shared_ptr<Face3D>> & level_faces(size_t level) const
+    {
+        return level == 0 ? _faces : _level_faces[level - 1];
+    }
+
+    // Faces of a level of detail as indices into the vertices
+    const vector<Face> & level_indices(size_t level)
+    {
+        return level == 0 ? face_indices() : _levels.levels()[level - 1];
+    }
+
+    // Numbers of the faces of the level of detail that may be seen through the view volume
+    vector<size_t> visible_faces(const ViewVolume &view_volume, size_t level)
+    {
+        vector<size_t> faces;
+
+        hierarchy(level).traverse(
+            [&view_volume](const BoundingBox &box)
+            {
+                return view_volume.visibility(box);
+            },
+            [&faces](size_t face, Visibility)
+            {
+                faces.push_back(face);
+            });
+
+        return faces;
+    }
+
+    // Screen positions of the vertices, projected only when first needed
+    class ScreenPoints
+    {
+    public:
+
+        ScreenPoints(const ViewVolume &view_volume, const vector<shared_ptr<Coord3D>> &vertices):
+            _view_volume(view_volume), _vertices(vertices),
+            _points(vertices.size()), _projections(vertices.size(), UNKNOWN) {}
+
+        // True if vertex v can be projected.
+        bool projected(size_t v)
+        {
+            if (_projections[v] == UNKNOWN)
+            {
+                _projections[v] = _view_volume.screen_point(*_vertices[v], _points[v]) ? PROJECTED : UNPROJECTABLE;
+
+                if (_projections[v] == PROJECTED)
+                {
+                    _nearest = min(_nearest, _points[v].depth);
+                    _farthest = max(_farthest, _points[v].depth);
+                }
+            }
+
+            return _projections[v] == PROJECTED;
+        }
+
+        // True if all vertices of face can be projected.
+        bool projected(const Face &face)
+        {
+            bool all = true;
+
+            for (size_t v: face)
+                all = projected(v) && all;
+
+            return all;
+        }
+
+        const ScreenPoint & operator[](size_t v) const { return _points[v]; }
+
+        // Range of the depths of the vertices projected so far
+        double depth_range() const { return _farthest > _nearest ? _farthest - _nearest : 0; }
+
+    private:
+
+        enum Projection : char { UNKNOWN, PROJECTED, UNPROJECTABLE };
+
+        const ViewVolume &_view_volume;
+        const vector<shared_ptr<Coord3D>> &_vertices;
+        vector<ScreenPoint> _points;
+        vector<char> _projections;
+        double _nearest = numeric_limits<double>::infinity(), _farthest = -numeric_limits<double>::infinity();
+    };
+
+    // Light reaching faces facing the eye at a grazing angle, as a fraction of the light reaching faces facing it
+    constexpr static double ambient_light = 0.2;
+
+    // Fill the faces with the color of the view volume, flat shaded by a light at the eye, into its frame buffer.
+    // Faces reaching behind the near plane are cut by it.
+    void fill_faces(ViewVolume &view_volume, size_t level, const vector<size_t> &faces)
+    {
+        FrameBuffer &frame_buffer = *view_volume.frame_buffer();
+        const vector<shared_ptr<Face3D>> &face_objects = level_faces(level);
+        const vector<Face> &indices = level_indices(level);
+        const Color color = fill_color(view_volume.color());
+
+        ScreenPoints points(view_volume, _vertices);
+        vector<ScreenPoint> polygon;
+
+        for (size_t f: faces)
+        {
+            const Face &face = indices[f];
+            const double light = ambient_light + (1 - ambient_light) * abs(face_objects[f]->facing(view_volume, version()));
+            const uint32_t shade = argb(color.red() * light, color.green() * light, color.blue() * light);
+
+            if (points.projected(face))
+            {
+                for (size_t i = 1; i + 1 < face.size(); i++)
+                    frame_buffer.fill_triangle(points[face.front()], points[face[i]], points[face[i + 1]], shade);
+
+                continue;
+            }
+
+            near_part(view_volume, face, polygon);
+
+            for (size_t i = 1; i + 1 < polygon.size(); i++)
+                frame_buffer.fill_triangle(polygon.front(), polygon[i], polygon[i + 1], shade);
+        }
+    }
+
+    // Screen positions of the corners of the part of face in front of the near plane, where w is at least near_w
+    void near_part(const ViewVolume &view_volume, const Face &face, vector<ScreenPoint> &polygon) const
+    {
+        polygon.clear();
+
+        for (size_t i = 0; i < face.size(); i++)
+        {
+            const Coord3D &a = *_vertices[face[i]], &b = *_vertices[face[(i + 1) % face.size()]];
+            const double wa = view_volume.w(a), wb = view_volume.w(b);
+            ScreenPoint point;
+
+            if (wa >= near_w && view_volume.screen_point(a, point))
+                polygon.push_back(point);
+
+            if ((wa < near_w) == (wb < near_w)) continue;
+
+            if (view_volume.screen_point(between(a, b, (near_w - wa) / (wb - wa)), point))
+                polygon.push_back(point);
+        }
+    }
+
+    // Draw the parts of the edges of faces not hidden by the faces of any group rasterized in the frame.
+    // Each edge is split into pieces about a pixel long on the screen, and drawn where its pieces are in front of
+    // the depth buffer of the view volume.
+    void draw_visible_edges(Canvas<Coord3D> &canvas, ViewVolume &view_volume, size_t level, const vector<size_t> &faces)
+    {
+        const DepthBuffer &depth_buffer = *view_volume.depth_buffer();
+        const vector<Face> &indices = level_indices(level);
+        ScreenPoints points(view_volume, _vertices);
+        vector<pair<size_t, size_t>> edges;
+
+        for (size_t f: faces)
+        {
+            const Face &face = indices[f];
+
+            for (size_t i = 0; i < face.size(); i++)
+            {
+                const size_t a = face[i], b = face[(i + 1) % face.size()];
+                edges.push_back(make_pair(min(a, b), max(a, b)));
+            }
+
+            // Projected up front, so that the tolerance spans the depths of all the faces
+            points.projected(face);
+        }
+
+        sort(edges.begin(), edges.end());
+        edges.erase(unique(edges.begin(), edges.end()), edges.end());
+
+        const double tolerance = depth_tolerance * points.depth_range();
+
+        for (auto &edge: edges)
+        {
+            const Coord3D &from = *_vertices[edge.first], &to = *_vertices[edge.second];
+
+            if (!points.projected(edge.first) || !points.projected(edge.second))
+            {
+                canvas.move(from);
+                canvas.draw_line(to);
+                continue;
+            }
+
+            const ScreenPoint &a = points[edge.first], &b = points[edge.second];
+            const size_t pieces = max(size_t(1), min(size_t(max_edge_pieces), size_t(ceil(hypot(b.x - a.x, b.y - a.y)))));
+
+            auto at = [&from, &to, &a, &b, pieces](size_t piece)
+            {
+                return between(from, to, segment_parameter(a, b, double(piece) / pieces));
+            };
+
+            size_t first_visible = pieces;
+
+            for (size_t piece = 0; piece <= pieces; piece++)
+            {
+                bool visible = false;
+
+                if (piece < pieces)
+                {
+                    const double s = (piece + 0.5) / pieces;
+                    const double depth = a.depth + (b.depth - a.depth) * s;
+                    visible = depth <= depth_buffer.depth(a.x + (b.x - a.x) * s, a.y + (b.y - a.y) * s) + tolerance;
+                }
+
+                if (visible && first_visible == pieces)
+                {
+                    first_visible = piece;
+                }
+                else if (!visible && first_visible < pieces)
+                {
+                    canvas.move(at(first_visible));
+                    canvas.draw_line(at(piece));
+                    first_visible = pieces;
+                }
+            }
+        }
+    }
+
+    // Current positions of the vertices
+    vector<LevelsOfDetail::Position> positions() const
+    {
+        vector<LevelsOfDetail::Position> positions;
+
+        for (auto &v: _vertices)
+            positions.push_back({{ v->x(), v->y(), v->z() }});
+
+        return positions;
+    }
+
+    // Faces as indices into the vertices; computed once, as transforms do not change them.
+    const vector<Face> & face_indices()
+    {
+        if (!_face_indices.empty() || _faces.empty()) return _face_indices;
+
+        unordered_map<const Coord3D *, size_t> indices;
+        for (size_t i = 0; i < _vertices.size(); i++)
+            indices[_vertices[i].get()] = i;
+
+        for (auto &f: _faces)
+        {
+            Face face;
+            for (auto &v: f->vertices())
+                face.push_back(indices.at(v.get()));
+
+            _face_indices.push_back(face);
+        }
+
+        return _face_indices;
+    }
+
+    // Faces made of the group's vertices at the given indices
+    vector<shared_ptr<Face3D>> as_faces(const vector<Face> &level) const
+    {
+        vector<shared_ptr<Face3D>> faces;
+
+        for (auto &face: level)
+        {
+            list<shared_ptr<Coord3D>> vertices;
+            for (size_t i: face)
+                vertices.push_back(_vertices[i]);
+
+            faces.push_back(make_shared<Face3D>(vertices));
+        }
+
+        return faces;
+    }
+
+    // Hierarchy of the faces of a level of detail, built when first needed, or refit if the group was transformed since.
+    const BVH & hierarchy(size_t level)
+    {
+        if (_hierarchies.size() <= level) _hierarchies.resize(level + 1);
+
+        Hierarchy &hierarchy = _hierarchies[level];
+        if (hierarchy.valid && hierarchy.version == version()) return hierarchy.bvh;
+
+        const vector<shared_ptr<Face3D>> &faces = level_faces(level);
+
+        vector<BoundingBox> boxes;
+        boxes.reserve(faces.size());
+
+        for (auto &f: faces)
+            boxes.push_back(f->bounding_box());
+
+        if (hierarchy.valid)
+            hierarchy.bvh.refit(boxes);
+        else
+            hierarchy.bvh = BVH(boxes);
+
+        hierarchy.version = version();
+        hierarchy.valid = true;
+
+        return hierarchy.bvh;
+    }
+
+    // Hierarchy of the faces of a level of detail, with the version of the group it was fit to
+    struct Hierarchy
+    {
+        BVH bvh;
+        unsigned long version = 0;
+        bool valid = false;
+    };
+
     vector<shared_ptr<Coord3D>> _vertices;
     vector<shared_ptr<Face3D>> _faces;
+    vector<Face> _face_indices;
+
+    vector<Hierarchy> _hierarchies;
+
+    LevelsOfDetail _levels;
+    vector<vector<shared_ptr<Face3D>>> _level_faces;
+    bool _levels_drawn = false;
 
 };
 
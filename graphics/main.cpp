@@ -284,12 +284,59 @@ static void select_lb(GtkWidget UNUSED *menu_item, gpointer canvas)
     refresh_canvas(GTK_WIDGET(canvas), selection);
 }
 
+// Clip with a guard band of half size band, in Window coords.
+static void use_guard_band(gpointer canvas, double band)
+{
+    clipping_method = ClippingMethod::GUARD_BAND;
+    guard_band() = band;
+    refresh_canvas(GTK_WIDGET(canvas), selection);
+}
+
+static void select_narrow_guard_band(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    use_guard_band(canvas, 2);
+}
+
+static void select_guard_band(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    use_guard_band(canvas, 8);
+}
+
+static void select_wide_guard_band(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    use_guard_band(canvas, 32);
+}
+
 static void select_none(GtkWidget UNUSED *menu_item, gpointer canvas)
 {
     clipping_method = ClippingMethod::NONE;
     refresh_canvas(GTK_WIDGET(canvas), selection);
 }
 
+static void select_sh(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    polygon_clipping_method = PolygonClippingMethod::SUTHERLAND_HODGMAN;
+    refresh_canvas(GTK_WIDGET(canvas), selection);
+}
+
+static void select_wa(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    polygon_clipping_method = PolygonClippingMethod::WEILER_ATHERTON;
+    refresh_canvas(GTK_WIDGET(canvas), selection);
+}
+
+static void select_adaptive_curves(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    curve_method = CurveMethod::ADAPTIVE;
+    refresh_canvas(GTK_WIDGET(canvas), selection);
+}
+
+static void select_fixed_step_curves(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    curve_method = CurveMethod::FIXED_STEP;
+    refresh_canvas(GTK_WIDGET(canvas), selection);
+}
+
 static GtkWidget *button_orthogonal;
 static GtkWidget *button_perspective;
 
@@ -345,6 +392,54 @@ static void select_fd_surface_method(GtkWidget UNUSED *menu_item, gpointer canva
     refresh_canvas(GTK_WIDGET(canvas), selection);
 }
 
+static void select_adaptive_surface_method(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    surface_method = SurfaceMethod ::ADAPTIVE;
+    refresh_canvas(GTK_WIDGET(canvas), selection);
+}
+
+static void select_automatic_detail_method(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    detail_method = DetailMethod::AUTOMATIC;
+    refresh_canvas(GTK_WIDGET(canvas), selection);
+}
+
+static void select_full_detail_method(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    detail_method = DetailMethod::FULL;
+    refresh_canvas(GTK_WIDGET(canvas), selection);
+}
+
+static void select_no_hidden_line_method(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    hidden_line_method = HiddenLineMethod::NONE;
+    refresh_canvas(GTK_WIDGET(canvas), selection);
+}
+
+static void select_back_face_culling_hidden_line_method(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    hidden_line_method = HiddenLineMethod::BACK_FACE_CULLING;
+    refresh_canvas(GTK_WIDGET(canvas), selection);
+}
+
+static void select_depth_buffer_hidden_line_method(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    hidden_line_method = HiddenLineMethod::DEPTH_BUFFER;
+    refresh_canvas(GTK_WIDGET(canvas), selection);
+}
+
+static void select_wireframe_fill_method(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    fill_method = FillMethod::WIREFRAME;
+    refresh_canvas(GTK_WIDGET(canvas), selection);
+}
+
+static void select_solid_fill_method(GtkWidget UNUSED *menu_item, gpointer canvas)
+{
+    fill_method = FillMethod::SOLID;
+    refresh_canvas(GTK_WIDGET(canvas), selection);
+}
+
 static void select_cube_world(GtkWidget UNUSED *menu_item, gpointer canvas)
 {
     selected_world = SelectedWorld::CUBE;
@@ -623,6 +718,11 @@ static gboolean canvas_on_key_press(GtkWidget *canvas, GdkEventKey *event, gpoin
             select_or_hide_tool_buttons({ button_move, button_scale, button_rotate });
             break;
 
+        case GDK_KEY_E:
+        case GDK_KEY_e:
+            export_frame("frame.svg");
+            break;
+
         case GDK_KEY_G:
         case GDK_KEY_g:
             select_tool_translate();
@@ -638,6 +738,15 @@ static gboolean canvas_on_key_press(GtkWidget *canvas, GdkEventKey *event, gpoin
             select_tool_rotate();
             break;
 
+        case GDK_KEY_plus:
+        case GDK_KEY_equal:
+            selection.scale_steps(2);
+            break;
+
+        case GDK_KEY_minus:
+            selection.scale_steps(0.5);
+            break;
+
 #ifdef WORLD_3D
         case GDK_KEY_X:
         case GDK_KEY_x:
@@ -895,18 +1004,48 @@ int main(int argc, char *argv[])
     menu_bar_attach(menu_bar, canvas, "World", world_items);
 
     list<pair<string, GCallback>> surface_method_items;
+    surface_method_items.push_back(make_pair("Adaptive", G_CALLBACK(select_adaptive_surface_method)));
     surface_method_items.push_back(make_pair("Forward-Difference", G_CALLBACK(select_fd_surface_method)));
     surface_method_items.push_back(make_pair("Regular", G_CALLBACK(select_regular_surface_method)));
     menu_bar_attach(menu_bar, canvas, "Surface", surface_method_items);
 
+    list<pair<string, GCallback>> detail_method_items;
+    detail_method_items.push_back(make_pair("Automatic", G_CALLBACK(select_automatic_detail_method)));
+    detail_method_items.push_back(make_pair("Full", G_CALLBACK(select_full_detail_method)));
+    menu_bar_attach(menu_bar, canvas, "Detail", detail_method_items);
+
+    list<pair<string, GCallback>> hidden_line_method_items;
+    hidden_line_method_items.push_back(make_pair("None", G_CALLBACK(select_no_hidden_line_method)));
+    hidden_line_method_items.push_back(make_pair("Back-Face Culling", G_CALLBACK(select_back_face_culling_hidden_line_method)));
+    hidden_line_method_items.push_back(make_pair("Depth Buffer", G_CALLBACK(select_depth_buffer_hidden_line_method)));
+    menu_bar_attach(menu_bar, canvas, "Hidden Lines", hidden_line_method_items);
+
+    list<pair<string, GCallback>> fill_method_items;
+    fill_method_items.push_back(make_pair("Wireframe", G_CALLBACK(select_wireframe_fill_method)));
+    fill_method_items.push_back(make_pair("Solid", G_CALLBACK(select_solid_fill_method)));
+    menu_bar_attach(menu_bar, canvas, "Fill", fill_method_items);
+
 #endif
 
     list<pair<string, GCallback>> clipping_items;
     clipping_items.push_back(make_pair("Cohen-Sutherland", G_CALLBACK(select_cs)));
     clipping_items.push_back(make_pair("Liang-Barsky", G_CALLBACK(select_lb)));
+    clipping_items.push_back(make_pair("Narrow Guard Band", G_CALLBACK(select_narrow_guard_band)));
+    clipping_items.push_back(make_pair("Guard Band", G_CALLBACK(select_guard_band)));
+    clipping_items.push_back(make_pair("Wide Guard Band", G_CALLBACK(select_wide_guard_band)));
     clipping_items.push_back(make_pair("None", G_CALLBACK(select_none)));
     menu_bar_attach(menu_bar, canvas, "Clipping", clipping_items);
 
+    list<pair<string, GCallback>> polygon_clipping_items;
+    polygon_clipping_items.push_back(make_pair("Sutherland-Hodgman", G_CALLBACK(select_sh)));
+    polygon_clipping_items.push_back(make_pair("Weiler-Atherton", G_CALLBACK(select_wa)));
+    menu_bar_attach(menu_bar, canvas, "Polygon Clipping", polygon_clipping_items);
+
+    list<pair<string, GCallback>> curve_method_items;
+    curve_method_items.push_back(make_pair("Adaptive", G_CALLBACK(select_adaptive_curves)));
+    curve_method_items.push_back(make_pair("Fixed Step", G_CALLBACK(select_fixed_step_curves)));
+    menu_bar_attach(menu_bar, canvas, "Curves", curve_method_items);
+
     new_list_label(grid, "Object List:");
     list_box = new_list_box(grid, canvas, selection, G_CALLBACK(select_object));
 
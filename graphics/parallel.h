@@ -0,0 +1,146 @@
+// Work spread over the cores of the machine
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Number of threads to spread work over
+inline size_t thread_count()
+{
+    return max(1u, thread::hardware_concurrency());
+}
+
+// Threads kept for the whole run of the program, taking part in the work of parallel_for calls.
+// Work is queued as jobs of numbered items; the thread queuing a job takes items as well, so a job always
+// completes, even when all workers are busy, and work queued from inside a job runs as a job of its own
+// rather than on threads of its own.
+class WorkerPool
+{
+public:
+
+    // Pool shared by all parallel_for calls
+    static WorkerPool & shared()
+    {
+        static WorkerPool pool;
+        return pool;
+    }
+
+    ~WorkerPool()
+    {
+        {
+            lock_guard<mutex> lock(_mutex);
+            _stopping = true;
+        }
+
+        _available.notify_all();
+
+        for (auto &worker: _workers)
+            worker.join();
+    }
+
+    // Call work(item, thread) for every item from 0 to count on up to threads threads, the calling thread included
+    // as thread 0. Returns once all items are done.
+    void run(size_t count, size_t threads, const function<void(size_t, size_t)> &work)
+    {
+        shared_ptr<Job> job = make_shared<Job>(count, threads, work);
+
+        if (threads > 1 && count > 1)
+        {
+            {
+                lock_guard<mutex> lock(_mutex);
+
+                // Grown to the largest number of threads asked for
+                while (_workers.size() + 1 < threads)
+                    _workers.emplace_back([this]() { serve(); });
+
+                _jobs.push_back(job);
+            }
+
+            _available.notify_all();
+        }
+
+        job->take(0);
+
+        unique_lock<mutex> lock(_mutex);
+        _jobs.erase(remove(_jobs.begin(), _jobs.end(), job), _jobs.end());
+        _finished.wait(lock, [&job]() { return job->done == job->count; });
+    }
+
+private:
+
+    // Items of work, taken one at a time by the threads joining it
+    struct Job
+    {
+        Job(size_t count, size_t threads, const function<void(size_t, size_t)> &work):
+            count(count), threads(threads), work(work), next(0), done(0), joined(1) {}
+
+        // Do the items not taken yet as thread, until there are none left.
+        void take(size_t thread)
+        {
+            for (size_t item = next++; item < count; item = next++)
+            {
+                work(item, thread);
+                done++;
+            }
+        }
+
+        const size_t count, threads;
+        const function<void(size_t, size_t)> &work;
+        atomic<size_t> next, done;
+
+        // Threads joined so far, numbering the next one; guarded by the mutex of the pool
+        size_t joined;
+    };
+
+    // Join the queued jobs while the pool lasts.
+    void serve()
+    {
+        unique_lock<mutex> lock(_mutex);
+
+        while (true)
+        {
+            _available.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+            if (_stopping) return;
+
+            shared_ptr<Job> job = _jobs.front();
+            const size_t thread = job->joined++;
+
+            // Jobs with all their threads or all their items taken are of no use to the next worker.
+            if (thread + 1 >= job->threads || job->next >= job->count) _jobs.pop_front();
+            if (thread >= job->threads) continue;
+
+            lock.unlock();
+            job->take(thread);
+            lock.lock();
+
+            _finished.notify_all();
+        }
+    }
+
+    mutex _mutex;
+    condition_variable _available, _finished;
+    deque<shared_ptr<Job>> _jobs;
+    vector<std::thread> _workers;
+    bool _stopping = false;
+
+};
+
+// Call work(item, thread) for every item from 0 to count on threads numbered from 0, the calling thread included.
+// Each thread takes the next item as soon as it is done with the previous one, so that items may take varying time.
+// The threads are taken from a pool kept for the whole run; calls made from inside work are shared with the
+// threads of the pool that are idle. Returns once all items are done.
+template<class Work>
+void parallel_for(size_t count, size_t threads, Work work)
+{
+    WorkerPool::shared().run(count, threads, work);
+}
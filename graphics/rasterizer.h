@@ -0,0 +1,304 @@
+// Rasterization of projected polygons for visibility tests and solid rendering
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// Point projected on the screen, in pixels, with its depth and homogeneous w.
+// Depth grows away from the eye, and both x, y and depth vary linearly on the screen along projected lines.
+struct ScreenPoint
+{
+    double x, y, depth, w;
+};
+
+// Screen-space parameter s along the projection of segment (a, b) converted to the parameter along the segment itself
+inline double segment_parameter(const ScreenPoint &a, const ScreenPoint &b, double s)
+{
+    return s * a.w / ((1 - s) * b.w + s * a.w);
+}
+
+// Visit each pixel of a width x height screen whose center is covered by triangle (a, b, c), with the depth there.
+template<class Visit>
+void rasterize_triangle(const ScreenPoint &a, const ScreenPoint &b, const ScreenPoint &c, long width, long height, Visit visit)
+{
+    const double area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (area == 0) return;
+
+    const long left = max(0L, (long) floor(min({ a.x, b.x, c.x })));
+    const long right = min(width - 1, (long) ceil(max({ a.x, b.x, c.x })));
+    const long top = max(0L, (long) floor(min({ a.y, b.y, c.y })));
+    const long bottom = min(height - 1, (long) ceil(max({ a.y, b.y, c.y })));
+
+    for (long y = top; y <= bottom; y++)
+    {
+        const double py = y + 0.5;
+
+        for (long x = left; x <= right; x++)
+        {
+            const double px = x + 0.5;
+
+            // Barycentric weights, all of the same sign as the area inside the triangle
+            const double wa = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) / area;
+            const double wb = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) / area;
+            const double wc = 1 - wa - wb;
+
+            if (wa < 0 || wb < 0 || wc < 0) continue;
+
+            visit(x, y, wa * a.depth + wb * b.depth + wc * c.depth);
+        }
+    }
+}
+
+// Depth of the nearest surface at each pixel of the screen
+class DepthBuffer
+{
+public:
+
+    DepthBuffer(long width, long height):
+        _width(width), _height(height), _depths(size_t(width * height), numeric_limits<double>::infinity()) {}
+
+    long width() const { return _width; }
+    long height() const { return _height; }
+
+    // Forget all surfaces.
+    void clear()
+    {
+        fill(_depths.begin(), _depths.end(), numeric_limits<double>::infinity());
+    }
+
+    // Keep the depth of the triangle at the pixels it covers where it is the nearest surface.
+    void rasterize(const ScreenPoint &a, const ScreenPoint &b, const ScreenPoint &c)
+    {
+        rasterize_triangle(a, b, c, _width, _height, [this](long x, long y, double depth)
+        {
+            double &nearest = _depths[size_t(y * _width + x)];
+            if (depth < nearest) nearest = depth;
+        });
+    }
+
+    // Depth of the nearest surface at the pixel containing (x, y); infinite if none or out of the screen.
+    double depth(double x, double y) const
+    {
+        if (x < 0 || y < 0 || x >= _width || y >= _height) return numeric_limits<double>::infinity();
+
+        return _depths[size_t(long(y) * _width + long(x))];
+    }
+
+private:
+
+    long _width, _height;
+    vector<double> _depths;
+
+};
+
+// Pixel color in 32-bit ARGB, with full alpha
+inline uint32_t argb(double red, double green, double blue)
+{
+    auto channel = [](double value) { return uint32_t(lround(min(1.0, max(0.0, value)) * 255)); };
+
+    return 0xff000000u | channel(red) << 16 | channel(green) << 8 | channel(blue);
+}
+
+// Colors and integer depths of the pixels of the screen, for solid rendering
+class FrameBuffer
+{
+public:
+
+    // Integer depth of the nearest and of the farthest depth in range
+    constexpr static int32_t nearest_depth = 0;
+    constexpr static int32_t farthest_depth = 1 << 30;
+
+    // Integer depths subtracted from those of lines, so that lines lying on a surface are not hidden by it
+    constexpr static int32_t line_depth_bias = farthest_depth >> 12;
+
+    // Frame of width x height pixels, whose left-top pixel is at (left, top) on the screen
+    FrameBuffer(long width, long height, long left = 0, long top = 0):
+        _width(width), _height(height), _left(left), _top(top),
+        _colors(make_shared<vector<uint32_t>>(size_t(width * height), 0)),
+        _depths(size_t(width * height), numeric_limits<int32_t>::max()) {}
+
+    long width() const { return _width; }
+    long height() const { return _height; }
+    long left() const { return _left; }
+    long top() const { return _top; }
+
+    // Pixels, row by row, in 32-bit ARGB; transparent where nothing was drawn.
+    const uint32_t * pixels() const
+    {
+        return _colors->data();
+    }
+
+    // Color of the pixel at (x, y) of the frame
+    uint32_t color(long x, long y) const
+    {
+        return (*_colors)[size_t(y * _width + x)];
+    }
+
+    // Integer depth of the pixel at (x, y) of the frame
+    int32_t depth(long x, long y) const
+    {
+        return _depths[size_t(y * _width + x)];
+    }
+
+    // Frame sharing the colors of the pixels of this one, without its depths, to keep what was drawn at the cost of
+    // a reference; nothing is to be drawn into either once taken.
+    FrameBuffer picture() const
+    {
+        return FrameBuffer(*this, _colors);
+    }
+
+    // True if anything was drawn.
+    bool drawn() const
+    {
+        return _drawn;
+    }
+
+    // Map depths from nearest to farthest onto the integer depths; depths out of range are clamped.
+    void set_depth_range(double nearest, double farthest)
+    {
+        _nearest = nearest;
+        _scale = farthest > nearest ? (farthest_depth - nearest_depth) / (farthest - nearest) : 0;
+    }
+
+    // Fill the pixels whose center is covered by triangle (a, b, c) on the screen with color, where it is the
+    // nearest surface.
+    void fill_triangle(const ScreenPoint &a, const ScreenPoint &b, const ScreenPoint &c, uint32_t color)
+    {
+        fill_frame_triangle(to_frame(a), to_frame(b), to_frame(c), color);
+    }
+
+    // Draw the line from a to b on the screen with color, a pixel wide, where it is not behind any surface.
+    // The line is first cut to the frame, so that only the pixels of the frame are stepped through.
+    void draw_line(const ScreenPoint &from, const ScreenPoint &to, uint32_t color)
+    {
+        const ScreenPoint a = to_frame(from), b = to_frame(to);
+        const double dx = b.x - a.x, dy = b.y - a.y;
+        double first = 0, last = 1;
+
+        // Parameters where the line is inside 0 <= x <= width and 0 <= y <= height
+        const double deltas[4] = { -dx, dx, -dy, dy }, room[4] = { a.x, _width - a.x, a.y, _height - a.y };
+
+        for (size_t i = 0; i < 4; i++)
+        {
+            if (deltas[i] == 0)
+            {
+                if (room[i] < 0) return;
+                continue;
+            }
+
+            const double t = room[i] / deltas[i];
+
+            if (deltas[i] < 0) first = max(first, t);
+            else last = min(last, t);
+        }
+
+        if (first > last) return;
+
+        const double da = integer_depth(a.depth), db = integer_depth(b.depth);
+        const long steps = max(1L, lround((last - first) * max(abs(dx), abs(dy))));
+
+        for (long i = 0; i <= steps; i++)
+        {
+            const double t = first + (last - first) * i / steps;
+            const long x = max(0L, min(_width - 1, long(a.x + dx * t)));
+            const long y = max(0L, min(_height - 1, long(a.y + dy * t)));
+            const int32_t depth = int32_t(lround(da + (db - da) * t)) - line_depth_bias;
+            const size_t pixel = size_t(y * _width + x);
+
+            if (depth > _depths[pixel]) continue;
+
+            _depths[pixel] = depth;
+            (*_colors)[pixel] = color;
+            _drawn = true;
+        }
+    }
+
+private:
+
+    FrameBuffer(const FrameBuffer &frame, shared_ptr<vector<uint32_t>> colors):
+        _width(frame._width), _height(frame._height), _left(frame._left), _top(frame._top),
+        _colors(colors), _drawn(frame._drawn) {}
+
+    // Position of point relative to the left-top pixel of the frame
+    ScreenPoint to_frame(const ScreenPoint &point) const
+    {
+        return { point.x - _left, point.y - _top, point.depth, point.w };
+    }
+
+    // Fill triangle (a, b, c) of the frame.
+    // Each row is reduced to a span between the edges of the triangle, filled by a branch-free loop over the
+    // integer depths of the span, which the compiler can vectorize.
+    void fill_frame_triangle(const ScreenPoint &a, const ScreenPoint &b, const ScreenPoint &c, uint32_t color)
+    {
+        const double area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (area == 0) return;
+
+        // Depth as a plane over the screen: depth = dx * x + dy * y + d0
+        const double da = integer_depth(a.depth), db = integer_depth(b.depth), dc = integer_depth(c.depth);
+        const double dx = ((db - da) * (c.y - a.y) - (dc - da) * (b.y - a.y)) / area;
+        const double dy = ((dc - da) * (b.x - a.x) - (db - da) * (c.x - a.x)) / area;
+        const double d0 = da - dx * a.x - dy * a.y;
+
+        const long top = max(0L, (long) ceil(min({ a.y, b.y, c.y }) - 0.5));
+        const long bottom = min(_height - 1, (long) floor(max({ a.y, b.y, c.y }) - 0.5));
+
+        const ScreenPoint *edges[3][2] = { { &a, &b }, { &b, &c }, { &c, &a } };
+        const int32_t step = int32_t(lround(dx));
+
+        for (long y = top; y <= bottom; y++)
+        {
+            const double py = y + 0.5;
+            double left = 0, right = _width;
+
+            for (auto &edge: edges)
+            {
+                const ScreenPoint &p = *edge[0], &q = *edge[1];
+
+                // Inside where (q - p) x (pixel - p) has the sign of the area, i.e. nx * x >= n0
+                const double nx = (area > 0 ? -1 : 1) * (q.y - p.y);
+                const double n0 = nx * p.x - (area > 0 ? 1 : -1) * (q.x - p.x) * (py - p.y);
+
+                if (nx > 0) left = max(left, n0 / nx);
+                else if (nx < 0) right = min(right, n0 / nx);
+                else if (n0 > 0) right = left - 1;
+            }
+
+            const long first = max(0L, (long) ceil(left - 0.5));
+            const long last = min(_width - 1, (long) floor(right - 0.5));
+            if (first > last) continue;
+
+            uint32_t *colors = &(*_colors)[size_t(y * _width)];
+            int32_t *depths = &_depths[size_t(y * _width)];
+            int32_t depth = int32_t(lround(dx * (first + 0.5) + dy * py + d0));
+
+            for (long x = first; x <= last; x++, depth += step)
+            {
+                const bool nearer = depth < depths[x];
+                depths[x] = nearer ? depth : depths[x];
+                colors[x] = nearer ? color : colors[x];
+            }
+
+            _drawn = true;
+        }
+    }
+
+    double integer_depth(double depth) const
+    {
+        return min(double(farthest_depth), max(double(nearest_depth), nearest_depth + (depth - _nearest) * _scale));
+    }
+
+    long _width, _height, _left, _top;
+    shared_ptr<vector<uint32_t>> _colors;
+    vector<int32_t> _depths;
+
+    double _nearest = 0, _scale = 0;
+    bool _drawn = false;
+
+};
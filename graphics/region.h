@@ -2,92 +2,88 @@
 
 #include "transforms.h"
 
-#include <bitset>
-#include <map>
-
 using namespace std;
 
 // Regions according to the World Window
 enum class Region { NORTH, NORTHEAST, EAST, SOUTHEAST, SOUTH, SOUTHWEST, WEST, NORTHWEST, CENTRAL };
 
-// Bitset to region mapping
-static map<string, Region> region_mapping
-    {
-        { "1000", Region::NORTH },
-        { "1010", Region::NORTHEAST },
-        { "0010", Region::EAST },
-        { "0110", Region::SOUTHEAST },
-        { "0100", Region::SOUTH },
-        { "0101", Region::SOUTHWEST },
-        { "0001", Region::WEST },
-        { "1001", Region::NORTHWEST },
-        { "0000", Region::CENTRAL },
-    };
+// Outcode of a point: one bit for each side of the window the point is beyond
+typedef unsigned RegionCode;
 
 constexpr int REGION_CODE_SIZE = 4;
-typedef bitset<REGION_CODE_SIZE> RegionCode;
 
-// Position of the super region in the region bit set.
-enum SuperRegionIndex: size_t {
-    NORTH = 1, SOUTH = 2, EAST = 3, WEST = 4
+// Bit of the super region in the region code
+enum SuperRegion: RegionCode {
+    NORTH = 1 << 3, SOUTH = 1 << 2, EAST = 1 << 1, WEST = 1 << 0
 };
 
-// Determine actual super region index based on the size of the bitset.
-inline size_t bitset_index(size_t index)
+// Region code to region mapping, indexed by code; codes of no region, such as north and south, map to central.
+constexpr Region region_mapping[1 << REGION_CODE_SIZE]
+    {
+        Region::CENTRAL, Region::WEST, Region::EAST, Region::CENTRAL,
+        Region::SOUTH, Region::SOUTHWEST, Region::SOUTHEAST, Region::CENTRAL,
+        Region::NORTH, Region::NORTHWEST, Region::NORTHEAST, Region::CENTRAL,
+        Region::CENTRAL, Region::CENTRAL, Region::CENTRAL, Region::CENTRAL,
+    };
+
+// Determine the region code of Window position (x, y).
+constexpr RegionCode region_code(double x, double y)
 {
-    return REGION_CODE_SIZE - index; // bitset has indexes in reserve order - LSB order.
+    return (x < -1 ? WEST : x > +1 ? EAST : 0u) | (y < -1 ? SOUTH : y > +1 ? NORTH : 0u);
 }
 
-// Determine the region code based on the Window vector.
-inline RegionCode region_code(const TVector &v)
+// Determine the region code based on the Window coord.
+template<class Coord>
+inline RegionCode region_code(const Coord &coord)
 {
-    const double x = v[0], y = v[1];
-
-    RegionCode code { "0000" };
+    static_assert(is_base_of<XYCoord<Coord>, Coord>::value, "Coord must derive from XYCoord<Coord>");
 
-    if (x < -1) code.set(bitset_index(WEST)); else if (x > +1) code.set(bitset_index(EAST));
-    if (y < -1) code.set(bitset_index(SOUTH)); else if (y > +1) code.set(bitset_index(NORTH));
+    return region_code(coord.x(), coord.y());
+}
 
-    return code;
+// Determine the region code based on the Window vector.
+inline RegionCode region_code(const TVector &v)
+{
+    return region_code(v[0], v[1]);
 }
 
 // Determine the region based on the code.
-inline Region region(RegionCode code)
+constexpr Region region(RegionCode code)
 {
-    for (auto &item: region_mapping)
-        if (code == RegionCode { item.first })
-            return item.second;
-
-    return Region::CENTRAL;
+    return region_mapping[code & ((1 << REGION_CODE_SIZE) - 1)];
 }
 
-// Determine the region based on Window vector.
-inline Region region(const TVector &v)
+// Determine the region based on Window vector or coord.
+template<class Vector>
+inline Region region(const Vector &v)
 {
     return region(region_code(v));
 }
 
 // Determine if vector is located in super region i.
-inline bool in_super_region(SuperRegionIndex i, const TVector &v)
+template<class Vector>
+inline bool in_super_region(SuperRegion i, const Vector &v)
 {
-    return region_code(v).test(bitset_index(i));
+    return (region_code(v) & i) != 0;
 }
 
 // Determine if line between a and b is fully located in super region i.
-inline bool in_super_region(SuperRegionIndex i, const TVector &a, const TVector &b)
+template<class Vector>
+inline bool in_super_region(SuperRegion i, const Vector &a, const Vector &b)
 {
-    return in_super_region(i, a) && in_super_region(i, b);
+    return (region_code(a) & region_code(b) & i) != 0;
 }
 
 // Determine if line between a and b is fully located in one super region.
-inline bool in_one_super_region(const TVector &a, const TVector &b)
+template<class Vector>
+inline bool in_one_super_region(const Vector &a, const Vector &b)
 {
-    return in_super_region(NORTH, a, b) || in_super_region(SOUTH, a, b) ||
-           in_super_region(EAST, a, b)  || in_super_region(WEST, a, b);
+    return (region_code(a) & region_code(b)) != 0;
 }
 
 // Determine which one between a nd b is in bounds.
-inline TVector choose_in_bounds(const TVector &a, const TVector &b)
+template<class Vector>
+inline Vector choose_in_bounds(const Vector &a, const Vector &b)
 {
-    if (region(a) == Region::CENTRAL) return a; else return b;
+    if (region_code(a) == 0) return a; else return b;
 }
@@ -1,26 +1,62 @@
 #pragma once
 
+#include "bezier_curve.h"
 #include "fd.h"
 
-// Generate the vertices to represent a Spline curve.
+// Generate the vertices to represent a Spline curve in step, adding them to coords.
 template<class Coord>
-inline list<shared_ptr<Coord>> spline_curve_vertices(vector<Coord> controls)
+inline void spline_curve_vertices(vector<Coord> &coords, const vector<Coord> &controls,
+                                  const ForwardDifferenceStep &step = ForwardDifferenceStep())
 {
     constexpr size_t start = TVector::last_index;
 
     assert(controls.size() > start);
 
-    list<shared_ptr<Coord>> result;
-
     for (size_t i = start; i < controls.size(); i++)
     {
         generate_fd_vertices(
-            result,
+            coords,
             vector_of(controls, i, 0),
             vector_of(controls, i, 1),
             vector_of(controls, i, 2),
-            spline);
+            spline,
+            step);
     }
+}
+
+// Generate the vertices to represent a Spline curve.
+template<class Coord>
+inline list<shared_ptr<Coord>> spline_curve_vertices(const vector<Coord> &controls,
+                                                     const ForwardDifferenceStep &step = ForwardDifferenceStep())
+{
+    vector<Coord> coords;
+    spline_curve_vertices(coords, controls, step);
+
+    list<shared_ptr<Coord>> result;
+    for (auto &coord: coords) result.push_back(make_shared<Coord>(coord));
 
     return result;
 }
+
+// Generate the vertices to represent a Spline curve within tolerance of it.
+// Each segment is subdivided as the Bezier curve with the same shape.
+template<class Coord>
+inline void adaptive_spline_curve_vertices(vector<Coord> &coords, const vector<Coord> &controls, double tolerance)
+{
+    constexpr size_t start = TVector::last_index;
+
+    assert(controls.size() > start);
+
+    for (size_t i = start; i < controls.size(); i++)
+    {
+        const TVector c0 = controls[i - 3], c1 = controls[i - 2], c2 = controls[i - 1], c3 = controls[i];
+
+        const TVector b0 = (c0 + c1 * 4 + c2) / 6;
+        const TVector b1 = (c1 * 2 + c2) / 3;
+        const TVector b2 = (c1 + c2 * 2) / 3;
+        const TVector b3 = (c1 + c2 * 4 + c3) / 6;
+
+        if (i == start) coords.push_back(Coord(b0));
+        subdivide_bezier(coords, b0, b1, b2, b3, tolerance);
+    }
+}
@@ -1,6 +1,7 @@
 #pragma once
 
-#include "transforms.h"
+#include "basis_table.h"
+#include "parallel.h"
 
 constexpr size_t surface_geometry_matrix_size = TMatrix::cell_count;
 
@@ -21,6 +22,56 @@ TMatrix surface_geometry_matrix(const vector<Coord> controls, size_t j)
     );
 }
 
+// Smallest number of patches given to each thread when the patches of a surface are tessellated in parallel
+constexpr size_t patches_per_thread = 4;
+
+// Number of threads to tessellate count patches on
+inline size_t patch_threads(size_t count)
+{
+    return max(size_t(1), min(thread_count(), count / patches_per_thread));
+}
+
+// Tessellate the patches from 0 to count with generate(patch, vertices, ends) on threads, adding their chains to
+// vertices and ends in the order of the patches, so that the result does not depend on the number of threads.
+// Each patch is generated into buffers of its own, then copied into its slice of vertices, allocated once for all.
+template<class Coord, typename Generate>
+inline void generate_patches(vector<Coord> &vertices, vector<size_t> &ends, size_t count, Generate generate,
+                             size_t threads)
+{
+    if (threads <= 1)
+    {
+        for (size_t patch = 0; patch < count; patch++) generate(patch, vertices, ends);
+        return;
+    }
+
+    vector<vector<Coord>> patch_vertices(count);
+    vector<vector<size_t>> patch_ends(count);
+
+    parallel_for(count, threads, [&generate, &patch_vertices, &patch_ends](size_t patch, size_t)
+    {
+        generate(patch, patch_vertices[patch], patch_ends[patch]);
+    });
+
+    size_t size = vertices.size();
+    for (auto &v: patch_vertices) size += v.size();
+    vertices.reserve(size);
+
+    for (size_t patch = 0; patch < count; patch++)
+    {
+        const size_t first = vertices.size();
+
+        vertices.insert(vertices.end(), patch_vertices[patch].begin(), patch_vertices[patch].end());
+        for (auto end: patch_ends[patch]) ends.push_back(first + end);
+    }
+}
+
+// Tessellate the patches from 0 to count with generate(patch, vertices, ends), in parallel when there are many.
+template<class Coord, typename Generate>
+inline void generate_patches(vector<Coord> &vertices, vector<size_t> &ends, size_t count, Generate generate)
+{
+    generate_patches(vertices, ends, count, generate, patch_threads(count));
+}
+
 // Create TMatrix for surface, from controls i to i+16, extracting the j-th position of each vector.
 template<class Coord>
 TMatrix surface_matrix(const TMatrix &curve_matrix, const vector<Coord> &controls, size_t j)
@@ -28,81 +79,84 @@ TMatrix surface_matrix(const TMatrix &curve_matrix, const vector<Coord> &control
     return transposed(curve_matrix) * surface_geometry_matrix(controls, j) * curve_matrix;
 }
 
-// Generate the vertices to represent a surface.
-template<class Coord, typename CoordMaker>
-inline void generate_surface_vertices(list<shared_ptr<Coord>> &coords, CoordMaker make_coord, bool transversal = false)
+// Number of lines drawn along each curve of a surface, and of curves drawn in each direction, unless set for the surface
+constexpr size_t surface_curve_steps = 20;
+
+// Generate the vertices to represent a surface with coefficient matrices mx, my and mz in steps, as curves along t
+// for each step of s, or along s for each step of t if transversal, each curve run in the opposite direction of the
+// previous one. The powers of s and t come from a table, and each curve takes the product of its matrices with its
+// constant parameter once, leaving a dot product per coordinate of each vertex.
+template<class Coord>
+inline void generate_surface_vertices(list<shared_ptr<Coord>> &coords, const TMatrix &mx, const TMatrix &my,
+                                      const TMatrix &mz, bool transversal = false, size_t steps = surface_curve_steps)
 {
     static_assert(is_convertible<TVector, Coord>::value, "Coord must have constructor: Coord(const TVector &)");
 
-    double min = 0, max = 1;
-    double ss = min, sf = max, ds = 0.05;
-    double ts = min, tf = max, dt = ds;
+    const BasisTable &table = power_table(steps);
 
-    if (transversal)
-    {
-        swap(ss, sf);
-        ds = -ds;
-    }
+    // Constant s on rows of the matrices, constant t on their columns
+    const TMatrix cx = transversal ? transposed(mx) : mx;
+    const TMatrix cy = transversal ? transposed(my) : my;
+    const TMatrix cz = transversal ? transposed(mz) : mz;
 
-    for (double s = ss; (s > min && s < max) || equals(s, min) || equals(s, max); s += ds)
+    for (size_t i = 0; i <= steps; i++)
     {
-        const TVector vs = vector_of_step(s);
+        const TVector &vs = table[transversal ? steps - i : i];
+        const TVector x = vs * cx, y = vs * cy, z = vs * cz;
 
-        for (double t = ts; (t > min && t < max) || equals(t, min) || equals(t, max); t += dt)
+        for (size_t j = 0; j <= steps; j++)
         {
-            const TVector vt = vector_of_step(t);
+            const TVector &vt = table[i % 2 == 0 ? j : steps - j];
 
-            coords.push_back(transversal ? make_coord(vt, vs) : make_coord(vs, vt));
+            coords.push_back(make_shared<Coord>(x * vt, y * vt, z * vt));
         }
-
-        swap(ts, tf);
-        dt = -dt;
     }
 }
 
 // Generate the transversal vertices to represent a surface.
-template<class Coord, typename CoordMaker>
-inline void generate_transversal_surface_vertices(list<Coord> &coords, CoordMaker make_coord)
+template<class Coord>
+inline void generate_transversal_surface_vertices(list<shared_ptr<Coord>> &coords, const TMatrix &mx, const TMatrix &my,
+                                                  const TMatrix &mz, size_t steps = surface_curve_steps)
 {
-    generate_surface_vertices(coords, make_coord, true);
+    generate_surface_vertices(coords, mx, my, mz, true, steps);
 };
 
-// Generate the transversal vertices to represent a surface.
-template<class Coord, typename CoordMaker>
-inline void generate_surface_mesh(list<shared_ptr<Coord>> &coords, CoordMaker make_coord)
+// Generate the vertices to represent a surface, then its transversal vertices.
+template<class Coord>
+inline void generate_surface_mesh(list<shared_ptr<Coord>> &coords, const TMatrix &mx, const TMatrix &my,
+                                  const TMatrix &mz, size_t steps = surface_curve_steps)
 {
-    generate_surface_vertices(coords, make_coord);
-    generate_transversal_surface_vertices(coords, make_coord);
+    generate_surface_vertices(coords, mx, my, mz, false, steps);
+    generate_transversal_surface_vertices(coords, mx, my, mz, steps);
 };
 
-// Generate the vertices to represent a surface.
+// Generate the vertices to represent a surface, its patches in parallel when there are many.
 template<class Coord>
-inline list<shared_ptr<Coord>> surface_vertices(const TMatrix &curve_matrix, const vector<vector<Coord>> controls)
+inline list<shared_ptr<Coord>> surface_vertices(const TMatrix &curve_matrix, const vector<vector<Coord>> controls,
+                                                size_t steps = surface_curve_steps)
 {
     static_assert(is_convertible<TVector, Coord>::value, "Coord must have constructor: Coord(const TVector &)");
 
-    list<shared_ptr<Coord>> coords;
+    vector<list<shared_ptr<Coord>>> patches(controls.size());
 
-    for (auto &c: controls)
+    parallel_for(controls.size(), patch_threads(controls.size()),
+                 [&curve_matrix, &controls, steps, &patches](size_t patch, size_t)
     {
+        const vector<Coord> &c = controls[patch];
         assert(c.size() == surface_geometry_matrix_size);
 
         const TMatrix mx = surface_matrix(curve_matrix, c, 0);
         const TMatrix my = surface_matrix(curve_matrix, c, 1);
         const TMatrix mz = surface_matrix(curve_matrix, c, 2);
 
-        generate_surface_mesh(coords, [mx, my, mz] (const TVector &vs, const TVector &vt)
-        {
-            return make_shared<Coord>(
-                (vs * mx) * vt,
-                (vs * my) * vt,
-                (vs * mz) * vt
-            );
-        });
+        generate_surface_mesh(patches[patch], mx, my, mz, steps);
 
         // Not drawing lines between surface meshes.
-        coords.push_back(nullptr);
-    }
+        patches[patch].push_back(nullptr);
+    });
+
+    list<shared_ptr<Coord>> coords;
+    for (auto &patch: patches) coords.splice(coords.end(), patch);
 
     return coords;
 }
@@ -1,7 +1,7 @@
 #define WORLD_2D
 
 #include "min_unit.h"
-#include "../display.h"
+#include "../tools.h"
 
 //static void print(Coord2D coord)
 //{
@@ -133,12 +133,369 @@ static const char * from_viewport()
     return nullptr;
 }
 
+// Canvas counting the lines that reach the screen
+class LineCounter: public Canvas<VC>
+{
+public:
+
+    void move(const VC UNUSED &destination) override {}
+    void draw_line(const VC UNUSED &destination) override { lines++; }
+    void draw_circle(const VC UNUSED &center, const double UNUSED radius) override {}
+    void set_color(const Color UNUSED &color) override {}
+
+    int lines = 0;
+
+};
+
+// Line counting how many times it was drawn
+class CountedLine: public Line
+{
+public:
+
+    CountedLine(Coord2D a, Coord2D b): Line(a, b) {}
+
+    void draw(Canvas<Coord2D> &canvas) override
+    {
+        draws++;
+        Line::draw(canvas);
+    }
+
+    int draws = 0;
+
+};
+
+static const char * screen_cache()
+{
+    shared_ptr<Window<Coord2D>> window = make_shared<Window<Coord2D>>(Coord2D(50, 50), 100, 100);
+    shared_ptr<CountedLine> line = make_shared<CountedLine>(Coord2D(10, 10), Coord2D(90, 90));
+    Draw2DCommand command(line);
+
+    LineCounter screen;
+    ViewportCanvas<Coord2D> viewport(100, 100, window, screen);
+    window->set_viewport(viewport);
+
+    command.render(viewport);
+    command.render(viewport);
+    mu_assert(line->draws == 1);
+    mu_assert(screen.lines == 2);
+
+    line->translate(Coord2D(1, 1));
+    command.render(viewport);
+    mu_assert(line->draws == 2);
+    mu_assert(screen.lines == 3);
+
+    window->zoom_in(0.1);
+    command.render(viewport);
+    command.render(viewport);
+    mu_assert(line->draws == 3);
+    mu_assert(screen.lines == 5);
+
+    return nullptr;
+}
+
+static const char * subpixel_segments()
+{
+    shared_ptr<Window<Coord2D>> window = make_shared<Window<Coord2D>>(Coord2D(50, 50), 100, 100);
+
+    LineCounter screen;
+    ViewportCanvas<Coord2D> viewport(100, 100, window, screen);
+    window->set_viewport(viewport);
+
+    // Run of 20 segments, each about a tenth of a pixel long
+    viewport.move(Coord2D(10, 10));
+    for (int i = 1; i <= 20; i++)
+        viewport.draw_line(Coord2D(10 + i * 0.1, 10));
+
+    // Long segment, sent as is
+    viewport.move(Coord2D(20, 20));
+    viewport.draw_line(Coord2D(80, 20));
+
+    // Two tiny faces on the same pixel; the second one is dropped.
+    for (int face = 0; face < 2; face++)
+    {
+        const double offset = face * 0.05;
+        viewport.move(Coord2D(40.1 + offset, 40.1 + offset));
+        viewport.draw_line(Coord2D(40.3 + offset, 40.1 + offset));
+        viewport.draw_line(Coord2D(40.3 + offset, 40.3 + offset));
+        viewport.draw_line(Coord2D(40.1 + offset, 40.1 + offset));
+    }
+    viewport.set_color(BLACK);
+
+    const SegmentCounters &counters = viewport.counters();
+    mu_assert(counters.drawn == size_t(screen.lines));
+    mu_assert(counters.drawn + counters.merged + counters.dropped == 27);
+    mu_assert(counters.drawn <= 5);
+    mu_assert(counters.dropped == 3);
+
+    return nullptr;
+}
+
+// Canvas keeping the lines that reach the screen, in order
+class LineRecorder: public Canvas<VC>
+{
+public:
+
+    void move(const VC &destination) override { from = destination; }
+    void draw_line(const VC &destination) override { lines.push_back({ from, destination }); from = destination; }
+    void draw_circle(const VC UNUSED &center, const double UNUSED radius) override {}
+    void set_color(const Color UNUSED &color) override {}
+
+    VC from = VC(0, 0);
+    vector<pair<VC, VC>> lines;
+
+};
+
+// Canvas counting the colors set on it
+class ColorCounter: public LineRecorder
+{
+public:
+
+    void set_color(const Color &color) override { colors.push_back(color.red()); }
+
+    vector<double> colors;
+
+};
+
+static const char * subpixel_run_corners()
+{
+    shared_ptr<Window<Coord2D>> window = make_shared<Window<Coord2D>>(Coord2D(50, 50), 100, 100);
+
+    LineRecorder screen;
+    ViewportCanvas<Coord2D> viewport(100, 100, window, screen);
+    window->set_viewport(viewport);
+
+    // Run of sub-pixel segments ending at a corner, followed by a long segment from that corner
+    viewport.move(Coord2D(10, 10));
+    viewport.draw_line(Coord2D(10.3, 10));
+    viewport.draw_line(Coord2D(10.6, 10));
+    viewport.draw_line(Coord2D(40, 10));
+
+    // The run is sent up to the corner, and the long segment starts there.
+    mu_assert(screen.lines.size() == 2);
+    mu_assert(screen.lines[0].second == screen.lines[1].first);
+    mu_assert(screen.lines[1].first == window->world_to_viewport(Coord2D(10.6, 10)));
+
+    // Pixels at negative viewport coords are told apart.
+    LineCounter counter;
+    ViewportCanvas<Coord2D> outside(100, 100, window, counter);
+    window->set_viewport(outside);
+
+    for (int pixel = 0; pixel < 2; pixel++)
+    {
+        const Coord2D start(-10.2 - 2 * pixel, 140.2 + 5 * pixel);
+        mu_assert(window->world_to_viewport(start).x() < 0 && window->world_to_viewport(start).y() < 0);
+
+        outside.move(start);
+        outside.draw_line(Coord2D(start.x() + 0.3, start.y()));
+    }
+    outside.set_color(BLACK);
+
+    mu_assert(outside.counters().dropped == 0 && counter.lines == 2);
+
+    return nullptr;
+}
+
+// Screen keeping the pixels of the frames painted on it
+class FrameRecorder: public ColorCounter, public FrameCanvas
+{
+public:
+
+    void draw_frame(const FrameBuffer &frame) override { pixels.push_back(frame.pixels()); }
+
+    vector<const uint32_t *> pixels;
+
+};
+
+static const char * draw_list()
+{
+    DrawList list;
+    list.set_color(RED);
+    list.move(VC(1, 2));
+    list.draw_line(VC(3, 4));
+    list.draw_line(VC(5, 6));
+    list.set_color(DARK_GRAY);
+    list.draw_circle(VC(7, 8), 2);
+    list.draw_line(VC(9, 10));
+
+    // Frames are recorded sharing their pixels.
+    FrameBuffer frame(2, 2);
+    list.draw_frame(frame);
+    mu_assert(list.size() == 8);
+
+    FrameRecorder screen;
+    list.replay(screen);
+    mu_assert(screen.lines.size() == 3);
+    mu_assert(screen.pixels.size() == 1 && screen.pixels[0] == frame.pixels());
+    mu_assert(screen.lines[1].first == VC(3, 4) && screen.lines[1].second == VC(5, 6));
+    mu_assert(screen.colors.size() == 2 && screen.colors[1] == DARK_GRAY.red());
+
+    stringstream svg;
+    list.write_svg(svg, Viewport(100, 100));
+    mu_assert(svg.str().find("<rect x=\"2.5\" y=\"2.5\" width=\"95\" height=\"95\"/>") != string::npos);
+    mu_assert(svg.str().find("<g clip-path=\"url(#content)\">") != string::npos);
+    mu_assert(svg.str().find("stroke=\"rgb(255,0,0)\" d=\"M1 2 L3 4 L5 6\"") != string::npos);
+    mu_assert(svg.str().find("<circle cx=\"7\" cy=\"8\" r=\"2\" fill=\"rgb(77,77,77)\"/>") != string::npos);
+
+    // A line after a circle starts a path of its own at the current position.
+    mu_assert(svg.str().find("stroke=\"rgb(77,77,77)\" d=\"M5 6 L9 10\"") != string::npos);
+
+    list.clear();
+    mu_assert(list.size() == 0);
+
+    return nullptr;
+}
+
+// Listener ignoring the rendering process
+class NoListener: public RenderingListener<Coord2D>
+{
+public:
+
+    void beforeRendering(const Command UNUSED &command, Canvas UNUSED &canvas) override {}
+
+};
+
+// Display file of lines drawn with counted lines
+static DisplayFile<Coord2D> counted_lines(list<shared_ptr<CountedLine>> &lines)
+{
+    list<shared_ptr<DisplayCommand<Coord2D>>> commands;
+
+    for (int i = 0; i < 50; i++)
+    {
+        lines.push_back(make_shared<CountedLine>(Coord2D(10, 10 + i), Coord2D(90, 20 + i)));
+        commands.push_back(make_shared<Draw2DCommand>(lines.back()));
+    }
+
+    return DisplayFile<Coord2D>(commands);
+}
+
+static const char * parallel_recording()
+{
+    shared_ptr<Window<Coord2D>> window = make_shared<Window<Coord2D>>(Coord2D(50, 50), 100, 100);
+    NoListener listener;
+
+    list<shared_ptr<CountedLine>> serial_lines;
+    DisplayFile<Coord2D> serial_file = counted_lines(serial_lines);
+    LineRecorder serial_screen;
+    ViewportCanvas<Coord2D> serial(100, 100, window, serial_screen);
+    window->set_viewport(serial);
+    serial_file.render(serial, listener);
+
+    // Lines are drawn on the threads, reaching the screen only when the display file is rendered.
+    list<shared_ptr<CountedLine>> parallel_lines;
+    DisplayFile<Coord2D> parallel_file = counted_lines(parallel_lines);
+    LineRecorder parallel_screen;
+    ViewportCanvas<Coord2D> parallel(100, 100, window, parallel_screen);
+    parallel.record_in_parallel(parallel_file, 4);
+    mu_assert(parallel_screen.lines.empty());
+
+    parallel_file.render(parallel, listener);
+    for (auto &line: parallel_lines)
+        mu_assert(line->draws == 1);
+    mu_assert(parallel.counters().drawn == serial.counters().drawn);
+    mu_assert(parallel_screen.lines == serial_screen.lines);
+
+    // Only stale recordings are redrawn.
+    parallel_lines.front()->translate(Coord2D(1, 1));
+    parallel_lines.back()->translate(Coord2D(1, 1));
+    parallel.record_in_parallel(parallel_file, 4);
+    for (auto &line: parallel_lines)
+        mu_assert(line->draws == (line == parallel_lines.front() || line == parallel_lines.back() ? 2 : 1));
+
+    return nullptr;
+}
+
+static const char * single_pass_clipping()
+{
+    shared_ptr<Window<Coord2D>> window = make_shared<Window<Coord2D>>(Coord2D(50, 50), 100, 100);
+
+    LineCounter screen;
+    ViewportCanvas<Coord2D> viewport(100, 100, window, screen);
+    window->set_viewport(viewport);
+
+    // Open lines sticking out of the right side
+    ClippedPolyline lines(list<shared_ptr<Coord2D>> {
+        make_shared<Coord2D>(50, 80), make_shared<Coord2D>(50, 20), make_shared<Coord2D>(150, 20), make_shared<Coord2D>(150, 80)
+    });
+
+    ClippingBuffer clipped;
+    mu_assert(lines.clip_into(viewport, clipped) == Visibility::PARTIAL);
+    mu_assert(lines.visibility_in(viewport) == Visibility::PARTIAL);
+
+    // Same vertices as the clipped drawable, all in the window, in a single chain
+    const list<shared_ptr<Coord2D>> expected = dynamic_pointer_cast<Polyline2D>(lines.clipped_in(viewport))->vertices();
+    mu_assert(clipped.vertices.size() == expected.size() && clipped.vertices.size() == 3);
+    mu_assert(clipped.ends.size() == 1 && clipped.ends.back() == 3);
+    auto vertex = clipped.vertices.begin();
+    for (auto &expected_vertex: expected)
+    {
+        mu_assert(*vertex == *expected_vertex && viewport.contains(*vertex));
+        ++vertex;
+    }
+
+    // Lines leaving by the right side and coming back by the top, passing the right-top corner outside the window:
+    // clipped in a batch as the clipped drawable is, with the corner added for the line rejected
+    ClippedPolyline around(list<shared_ptr<Coord2D>> {
+        make_shared<Coord2D>(50, 50), make_shared<Coord2D>(150, 90), make_shared<Coord2D>(90, 150), make_shared<Coord2D>(50, 50)
+    });
+
+    for (auto method: { ClippingMethod::COHEN_SUTHERLAND, ClippingMethod::LIANG_BARSKY })
+    {
+        clipping_method = method;
+        ClippingBuffer around_clipped;
+        const Visibility visibility = around.clip_into(viewport, around_clipped);
+        const list<shared_ptr<Coord2D>> around_expected =
+            dynamic_pointer_cast<Polyline2D>(around.clipped_in(viewport))->vertices();
+        clipping_method = ClippingMethod::COHEN_SUTHERLAND;
+
+        mu_assert(visibility == Visibility::PARTIAL);
+        mu_assert(around_clipped.vertices.size() == around_expected.size() && around_clipped.ends.size() == 1);
+        mu_assert(find(around_clipped.vertices.begin(), around_clipped.vertices.end(), Coord2D(100, 100)) !=
+                  around_clipped.vertices.end());
+
+        auto around_vertex = around_clipped.vertices.begin();
+        for (auto &expected_vertex: around_expected)
+        {
+            mu_assert(equals(around_vertex->x(), expected_vertex->x()) && equals(around_vertex->y(), expected_vertex->y()));
+            ++around_vertex;
+        }
+    }
+
+    lines.draw_clipped(viewport, clipped);
+    viewport.set_color(BLACK);
+    const SegmentCounters &counters = viewport.counters();
+    mu_assert(counters.drawn + counters.merged + counters.dropped == 2);
+
+    // Rectangle sticking out of the right side, clipped as an area and closed along the window side
+    Polygon polygon(list<Coord2D> { Coord2D(50, 20), Coord2D(150, 20), Coord2D(150, 80), Coord2D(50, 80) });
+    mu_assert(polygon.clip_into(viewport, clipped) == Visibility::PARTIAL);
+    mu_assert(clipped.vertices.size() == 4 && clipped.ends.size() == 1);
+    for (auto &clipped_vertex: clipped.vertices)
+        mu_assert(viewport.contains(clipped_vertex));
+
+    polygon.draw_clipped(viewport, clipped);
+    viewport.set_color(BLACK);
+    mu_assert(counters.drawn + counters.merged + counters.dropped == 6);
+
+    // Reused when out of the window
+    Polygon outside(list<Coord2D> { Coord2D(150, 20), Coord2D(180, 20), Coord2D(180, 80) });
+    mu_assert(outside.clip_into(viewport, clipped) == Visibility::NONE);
+    mu_assert(clipped.vertices.empty() && clipped.ends.empty());
+
+    return nullptr;
+}
+
 void all_tests()
 {
     mu_test(to_world);
     mu_test(from_world);
     mu_test(to_viewport);
     mu_test(from_viewport);
+    mu_test(screen_cache);
+    mu_test(subpixel_segments);
+    mu_test(subpixel_run_corners);
+    mu_test(parallel_recording);
+    mu_test(draw_list);
+    mu_test(single_pass_clipping);
 
     if (projection_method == ProjectionMethod::PERSPECTIVE)
     {
@@ -8,7 +8,221 @@ static const char * test_translation()
     return nullptr;
 }
 
+// True if polygon has a vertex at (x, y).
+static bool has_vertex(const vector<PPC> &polygon, double x, double y)
+{
+    for (auto &vertex: polygon)
+        if (vertex == PPC(x, y)) return true;
+
+    return false;
+}
+
+static const char * test_sutherland_hodgman()
+{
+    vector<PPC> scratch;
+
+    // Square sticking out of the right-top corner: the corner is added.
+    vector<PPC> square { PPC(0, 0), PPC(2, 0), PPC(2, 2), PPC(0, 2) };
+    clip_polygon_using_sh(square, scratch);
+    mu_assert(square.size() == 4);
+    mu_assert(has_vertex(square, 1, 1) && has_vertex(square, 1, 0) && has_vertex(square, 0, 1));
+
+    // Window inside the polygon: the window itself
+    vector<PPC> around { PPC(-3, -3), PPC(3, -3), PPC(3, 3), PPC(-3, 3) };
+    clip_polygon_using_sh(around, scratch);
+    mu_assert(around.size() == 4 && has_vertex(around, -1, -1) && has_vertex(around, 1, 1));
+
+    // All outside
+    vector<PPC> outside { PPC(2, 2), PPC(3, 2), PPC(3, 3) };
+    clip_polygon_using_sh(outside, scratch);
+    mu_assert(outside.empty());
+
+    return nullptr;
+}
+
+// Area of the polygon, positive if it goes around counterclockwise
+static double area(const vector<PPC> &polygon)
+{
+    double area = 0;
+
+    const PPC *previous = &polygon.back();
+    for (auto &current: polygon)
+    {
+        area += previous->x() * current.y() - current.x() * previous->y();
+        previous = &current;
+    }
+
+    return area / 2;
+}
+
+static const char * test_weiler_atherton()
+{
+    WeilerAthertonClipper<PPC> clipper;
+    vector<PPC> clipped;
+    vector<size_t> ends;
+
+    // U shape, counterclockwise, whose arms stick out of the top: cut in two parts by the window
+    const vector<PPC> u {
+        PPC(-0.8, -0.5), PPC(0.8, -0.5), PPC(0.8, 2), PPC(0.4, 2),
+        PPC(0.4, 0), PPC(-0.4, 0), PPC(-0.4, 2), PPC(-0.8, 2)
+    };
+    clipper.clip(u, clipped, ends);
+    mu_assert(ends.size() == 1);
+    mu_assert(clipped.size() == 8);
+
+    // Same U upside down, with the arms sticking out of the bottom and the base cut away by the top
+    const vector<PPC> n {
+        PPC(-0.8, 2), PPC(-0.8, -2), PPC(-0.4, -2), PPC(-0.4, 1.5),
+        PPC(0.4, 1.5), PPC(0.4, -2), PPC(0.8, -2), PPC(0.8, 2)
+    };
+    clipper.clip(n, clipped, ends);
+    mu_assert(ends.size() == 2);
+    mu_assert(ends[0] == 4 && ends[1] == 8);
+    for (auto &vertex: clipped)
+        mu_assert(in_window_or_side(vertex));
+
+    // Clockwise square sticking out of the right-top corner: the corner is added.
+    const vector<PPC> square { PPC(0, 0), PPC(0, 2), PPC(2, 2), PPC(2, 0) };
+    clipper.clip(square, clipped, ends);
+    mu_assert(ends.size() == 1 && clipped.size() == 4);
+    mu_assert(has_vertex(clipped, 1, 1));
+
+    // Window inside the polygon, and polygon all inside the window
+    const vector<PPC> around { PPC(-3, -3), PPC(3, -3), PPC(3, 3), PPC(-3, 3) };
+    clipper.clip(around, clipped, ends);
+    mu_assert(ends.size() == 1 && clipped.size() == 4 && has_vertex(clipped, -1, 1));
+
+    const vector<PPC> inside { PPC(0, 0), PPC(0.5, 0), PPC(0.5, 0.5) };
+    clipper.clip(inside, clipped, ends);
+    mu_assert(ends.size() == 1 && clipped.size() == 3);
+
+    // Notch touching the right side at a vertex: the part left goes around the right corners, as if it did not.
+    const vector<PPC> notch {
+        PPC(-0.5, -2), PPC(3, -2), PPC(3, -0.5), PPC(1, 0), PPC(3, 0.5), PPC(3, 2), PPC(-0.5, 2)
+    };
+    clipper.clip(notch, clipped, ends);
+    mu_assert(ends.size() == 1 && equals(area(clipped), 3));
+    mu_assert(has_vertex(clipped, 1, -1) && has_vertex(clipped, 1, 1));
+
+    // Polygon around the window, touching a side at a vertex: the window itself
+    const vector<PPC> touching { PPC(-3, -3), PPC(3, -3), PPC(1, 0), PPC(3, 3), PPC(-3, 3) };
+    clipper.clip(touching, clipped, ends);
+    mu_assert(ends.size() == 1 && clipped.size() == 4 && equals(area(clipped), 4));
+
+    return nullptr;
+}
+
+static const char * test_guard_band()
+{
+    clipping_method = ClippingMethod::GUARD_BAND;
+
+    // Leaving the window, but not the band: drawn as it is
+    mu_assert(visibility(PPC(0, 0), PPC(3, 0)) == Visibility::FULL);
+
+    // Out of one side of the window: nothing to draw
+    mu_assert(visibility(PPC(2, -1), PPC(3, 1)) == Visibility::NONE);
+
+    // Leaving the band: clipped to the window
+    mu_assert(visibility(PPC(0, 0), PPC(2 * guard_band(), 0)) == Visibility::PARTIAL);
+    mu_assert(clip_line(PPC(0, 0), PPC(2 * guard_band(), 0)).second == PPC(1, 0));
+
+    clipping_method = ClippingMethod::COHEN_SUTHERLAND;
+
+    return nullptr;
+}
+
+// Largest distance from the points of the Bezier curve with controls a to d to the lines through vertices.
+static double bezier_error(const vector<Coord2D> &vertices, Coord2D a, Coord2D b, Coord2D c, Coord2D d)
+{
+    const TVector gx = vector_of<Coord2D>({ a, b, c, d }, 0), gy = vector_of<Coord2D>({ a, b, c, d }, 1);
+
+    double error = 0;
+    for (double step = 0; step <= 1; step += 1.0 / 1024)
+    {
+        const TVector weights = vector_of_step(step) * bezier;
+        const TVector point({ weights * gx, weights * gy, 1, 1 });
+
+        double nearest = INFINITY;
+        for (size_t i = 1; i < vertices.size(); i++)
+            nearest = min(nearest, segment_distance(point, vertices[i - 1], vertices[i]));
+
+        error = max(error, nearest);
+    }
+
+    return error;
+}
+
+static const char * test_adaptive_curves()
+{
+    const Coord2D a(0, 0), b(0, 100), c(100, 100), d(100, 0);
+
+    vector<Coord2D> coarse, fine;
+    adaptive_bezier_curve_vertices(coarse, a, b, c, d, 4.0);
+    adaptive_bezier_curve_vertices(fine, a, b, c, d, 0.25);
+
+    // Edges kept, more vertices for a smaller tolerance, each within it
+    mu_assert(coarse.front() == a && coarse.back() == d && fine.front() == a && fine.back() == d);
+    mu_assert(coarse.size() < fine.size());
+    mu_assert(bezier_error(coarse, a, b, c, d) <= 4.0 && bezier_error(fine, a, b, c, d) <= 0.25);
+
+    // A straight curve is a single line.
+    vector<Coord2D> straight;
+    adaptive_bezier_curve_vertices(straight, a, Coord2D(1, 1), Coord2D(2, 2), Coord2D(3, 3), 0.25);
+    mu_assert(straight.size() == 2);
+
+    // Spline segments join without repeating vertices.
+    vector<Coord2D> spline;
+    adaptive_spline_curve_vertices(spline, { a, b, c, d, Coord2D(200, 50) }, 0.25);
+    for (size_t i = 1; i < spline.size(); i++) mu_assert(spline[i] != spline[i - 1]);
+
+    // Cached tessellation follows the zoom by powers of two.
+    BezierCurve curve(a, b, d, c);
+    const Tessellation<Coord2D> *near = curve.tessellation(0.1);
+    const size_t near_size = near->vertices.size();
+    mu_assert(curve.tessellation(0.12)->vertices.size() == near_size);
+    mu_assert(curve.tessellation(10)->vertices.size() < near_size);
+
+    curve_method = CurveMethod::FIXED_STEP;
+    mu_assert(curve.tessellation(10)->vertices.size() == curve.vertices().size());
+    curve_method = CurveMethod::ADAPTIVE;
+
+    return nullptr;
+}
+
+static const char * test_curve_steps()
+{
+    const Coord2D a(0, 0), b(0, 100), c(100, 100), d(100, 0);
+
+    // Fixed steps set for each curve
+    BezierCurve bezier(a, b, d, c);
+    SplineCurve spline({ a, b, c, d, Coord2D(200, 50) });
+    mu_assert(bezier.vertices().size() == bezier_steps + 1);
+    mu_assert(spline.vertices().size() == 2 * (fd_steps + 1));
+
+    const unsigned long version = bezier.version();
+    bezier.set_steps(10);
+    spline.set_steps(5);
+    mu_assert(bezier.version() != version);
+    mu_assert(bezier.vertices().size() == 11 && spline.vertices().size() == 2 * 6);
+    mu_assert(*bezier.vertices().back() == d && spline.tessellation(0)->vertices.size() == 2 * 6);
+
+    // Finer detail makes adaptive curves more precise, and steps stay at least 1.
+    const size_t coarse = bezier.tessellation(1)->vertices.size();
+    bezier.set_steps(bezier_steps * 4);
+    mu_assert(bezier.tessellation(1)->vertices.size() > coarse);
+
+    bezier.set_steps(0);
+    mu_assert(bezier.steps() == 1);
+
+    return nullptr;
+}
+
 void all_tests()
 {
     mu_test(test_translation);
+    mu_test(test_sutherland_hodgman);
+    mu_test(test_weiler_atherton);
+    mu_test(test_guard_band);
+    mu_test(test_adaptive_curves);
+    mu_test(test_curve_steps);
 }
@@ -1,5 +1,31 @@
+#define WORLD_3D
+
 #include "min_unit.h"
 #include "../graphics3d.h"
+#include "../tools.h"
+
+#include <set>
+
+// Scope guard setting a global setting back to the value it had when constructed, even when a failed assertion
+// returns early, so that the following tests start from the defaults.
+template<class Setting>
+class Restore
+{
+public:
+
+    explicit Restore(Setting &setting): _setting(setting), _saved(setting) {}
+
+    ~Restore()
+    {
+        _setting = _saved;
+    }
+
+private:
+
+    Setting &_setting;
+    const Setting _saved;
+
+};
 
 static const char * at_index()
 {
@@ -80,6 +106,55 @@ static const char * delta()
     return nullptr;
 }
 
+static const char * forward_differences()
+{
+    const TVector cx({ 1, -2, 3, 4 }), cy({ 0, 5, -1, 2 }), cz({ -3, 0, 2, 1 });
+
+    for (size_t steps: { fd_steps, size_t(7), size_t(64) })
+    {
+        const ForwardDifferenceStep step(steps);
+
+        vector<Coord3D> vertices;
+        generate_fd_vertices(vertices, delta_vector(cx, step), delta_vector(cy, step), delta_vector(cz, step), steps);
+
+        // Points of the cubic curve at every step, from t = 0 to t = 1
+        mu_assert(vertices.size() == steps + 1);
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            const TVector t = vector_of_step(i * step.size());
+            mu_assert(vertices[i] == Coord3D(t * cx, t * cy, t * cz));
+        }
+    }
+
+    return nullptr;
+}
+
+static const char * basis_tables()
+{
+    const BasisTable &table = basis_table(bezier, 8);
+
+    // Weights of the Bezier basis at every step, from t = 0 to t = 1
+    mu_assert(table.steps() == 8);
+    for (size_t k = 0; k <= 8; k++)
+    {
+        const TVector expected = vector_of_step(k / 8.0) * bezier;
+        for (size_t i = TVector::first_index; i <= TVector::last_index; i++)
+            mu_assert(equals(table[k][i], expected[i]));
+    }
+
+    // Built once for each basis and number of steps
+    mu_assert(&basis_table(bezier, 8) == &table);
+    mu_assert(&basis_table(bezier, 9) != &table && &basis_table(spline, 8) != &table);
+
+    // Tables of powers up to precomputed_power_steps built up front, the others at first use
+    mu_assert(&power_table(8) == &power_table(8) && &power_table(8) != &basis_table(TMatrix(), 8));
+    mu_assert(&power_table(precomputed_power_steps + 1) == &basis_table(TMatrix(), precomputed_power_steps + 1));
+    for (size_t i = TVector::first_index; i <= TVector::last_index; i++)
+        mu_assert(equals(power_table(8)[3][i], basis_table(TMatrix(), 8)[3][i]));
+
+    return nullptr;
+}
+
 static const char * transformations()
 {
     mu_assert(Coord3D(1, 0, 0) * translation(Coord3D(1, 0, 0)) * z_rotation(90) * scaling(Coord3D(1, 3, 1)) == Coord3D(0, -6, 0));
@@ -87,6 +162,700 @@ static const char * transformations()
     return nullptr;
 }
 
+static const char * bounding_box()
+{
+    Object3D object({ Segment3D(Coord3D(1, 5, -2), Coord3D(4, 2, 3)), Segment3D(Coord3D(0, 3, 1), Coord3D(2, 2, 2)) });
+
+    mu_assert(Coord3D(object.bounding_box().min()) == Coord3D(0, 2, -2));
+    mu_assert(Coord3D(object.bounding_box().max()) == Coord3D(4, 5, 3));
+    mu_assert(Coord3D(object.bounding_box().corner(5)) == Coord3D(4, 2, 3));
+
+    object.translate(Coord3D(1, 1, 1));
+    mu_assert(Coord3D(object.bounding_box().min()) == Coord3D(1, 3, -1));
+    mu_assert(Coord3D(object.bounding_box().max()) == Coord3D(5, 6, 4));
+
+    return nullptr;
+}
+
+// Box of unit size with the smallest corner at x
+static BoundingBox unit_box(double x)
+{
+    BoundingBox box;
+    box.add(Coord3D(x, 0, 0));
+    box.add(Coord3D(x + 1, 1, 1));
+    return box;
+}
+
+static const char * bvh()
+{
+    vector<BoundingBox> boxes;
+    for (size_t i = 0; i < 100; i++) boxes.push_back(unit_box(i * 2));
+
+    BVH hierarchy(boxes);
+    mu_assert(hierarchy.nodes().size() > 1);
+    mu_assert(equals(hierarchy.nodes()[0].box.max()[0], 199));
+
+    // Visible region: x from 10 to 20
+    auto classify = [](const BoundingBox &box)
+    {
+        if (box.max()[0] < 10 || box.min()[0] > 20) return Visibility::NONE;
+        if (box.min()[0] >= 10 && box.max()[0] <= 20) return Visibility::FULL;
+        return Visibility::PARTIAL;
+    };
+
+    size_t visible_count = 0;
+    hierarchy.traverse(classify, [&visible_count](size_t, Visibility) { visible_count++; });
+    mu_assert(visible_count >= 6 && visible_count <= BVH::leaf_size * 2);
+
+    for (auto &box: boxes) box = unit_box(box.min()[0] + 1000);
+    hierarchy.refit(boxes);
+    mu_assert(equals(hierarchy.nodes()[0].box.min()[0], 1000));
+
+    visible_count = 0;
+    hierarchy.traverse(classify, [&visible_count](size_t, Visibility) { visible_count++; });
+    mu_assert(visible_count == 0);
+
+    return nullptr;
+}
+
+// Flat grid of size x size quads on the z = 0 plane
+static void grid(size_t size, vector<MeshDecimator::Position> &positions, vector<MeshDecimator::Face> &faces)
+{
+    for (size_t y = 0; y <= size; y++)
+        for (size_t x = 0; x <= size; x++)
+            positions.push_back({{ double(x), double(y), 0 }});
+
+    for (size_t y = 0; y < size; y++)
+        for (size_t x = 0; x < size; x++)
+        {
+            const size_t corner = y * (size + 1) + x;
+            faces.push_back({ corner, corner + 1, corner + size + 2, corner + size + 1 });
+        }
+}
+
+static const char * decimation()
+{
+    vector<MeshDecimator::Position> positions;
+    vector<MeshDecimator::Face> faces;
+    grid(16, positions, faces);
+
+    MeshDecimator decimator(positions, faces);
+    mu_assert(decimator.face_count() == 256);
+
+    decimator.decimate(32);
+    mu_assert(decimator.face_count() <= 32);
+
+    // Faces left are made of distinct original vertices, and still cover the corners of the grid.
+    set<size_t> used;
+    for (auto &face: decimator.faces())
+    {
+        const set<size_t> distinct(face.begin(), face.end());
+        mu_assert(face.size() >= 3);
+        mu_assert(distinct.size() == face.size());
+        for (size_t v: face)
+        {
+            mu_assert(v < positions.size());
+            used.insert(v);
+        }
+    }
+
+    mu_assert(used.count(0) && used.count(16) && used.count(16 * 17) && used.count(17 * 17 - 1));
+
+    return nullptr;
+}
+
+static const char * levels_of_detail()
+{
+    vector<MeshDecimator::Position> positions;
+    vector<MeshDecimator::Face> faces;
+    grid(32, positions, faces);
+
+    const vector<vector<MeshDecimator::Face>> levels = decimated_levels(positions, faces, 64);
+    mu_assert(levels.size() >= 3);
+
+    size_t previous = faces.size();
+    for (auto &level: levels)
+    {
+        mu_assert(level.size() <= previous / 2);
+        mu_assert(level.size() >= 64 / 2);
+        previous = level.size();
+    }
+
+    return nullptr;
+}
+
+static const char * face_normal()
+{
+    shared_ptr<Coord3D> a = make_shared<Coord3D>(0, 0, 0), b = make_shared<Coord3D>(1, 0, 0);
+    shared_ptr<Coord3D> c = make_shared<Coord3D>(1, 1, 0), d = make_shared<Coord3D>(0, 1, 0);
+    Face3D face({ a, b, c, d });
+
+    mu_assert(face.normal(0) == Coord3D(0, 0, 2));
+
+    // Kept until the version changes
+    a->rotate_x(90, Coord3D());
+    b->rotate_x(90, Coord3D());
+    c->rotate_x(90, Coord3D());
+    d->rotate_x(90, Coord3D());
+    mu_assert(face.normal(0) == Coord3D(0, 0, 2));
+
+    const Coord3D &normal = face.normal(1);
+    mu_assert(equals(normal.x(), 0) && equals(abs(normal.y()), 2) && equals(normal.z(), 0));
+
+    return nullptr;
+}
+
+static const char * depth_buffer()
+{
+    DepthBuffer buffer(10, 10);
+    mu_assert(buffer.depth(5, 5) == numeric_limits<double>::infinity());
+
+    // Square split into two triangles at depth 2, and a triangle in front of its left-top half at depth 1
+    buffer.rasterize({ 0, 0, 2, 1 }, { 10, 0, 2, 1 }, { 10, 10, 2, 1 });
+    buffer.rasterize({ 0, 0, 2, 1 }, { 10, 10, 2, 1 }, { 0, 10, 2, 1 });
+    buffer.rasterize({ 0, 0, 1, 1 }, { 10, 0, 1, 1 }, { 0, 10, 1, 1 });
+
+    mu_assert(equals(buffer.depth(1.5, 1.5), 1));
+    mu_assert(equals(buffer.depth(8.5, 8.5), 2));
+    mu_assert(buffer.depth(-1, 5) == numeric_limits<double>::infinity());
+    mu_assert(buffer.depth(5, 10) == numeric_limits<double>::infinity());
+
+    buffer.clear();
+    mu_assert(buffer.depth(1.5, 1.5) == numeric_limits<double>::infinity());
+
+    // Depth interpolated on the screen
+    buffer.rasterize({ 0, 0, 0, 1 }, { 10, 0, 10, 1 }, { 0, 10, 0, 1 });
+    mu_assert(equals(buffer.depth(3.2, 0.5), 3.5));
+
+    // Halfway on the screen between points at w = 1 and w = 3 is a quarter of the way in the world.
+    mu_assert(equals(segment_parameter({ 0, 0, 0, 1 }, { 0, 0, 0, 3 }, 0.5), 0.25));
+    mu_assert(equals(segment_parameter({ 0, 0, 0, 1 }, { 0, 0, 0, 1 }, 0.5), 0.5));
+
+    return nullptr;
+}
+
+static const char * frame_buffer()
+{
+    FrameBuffer frame(10, 10);
+    frame.set_depth_range(0, 10);
+    mu_assert(!frame.drawn());
+
+    const uint32_t red = argb(1, 0, 0), green = argb(0, 1, 0);
+    mu_assert(red == 0xffff0000u);
+
+    // Green square at depth 5, then a red triangle behind it on its left half and in front of it on its right half
+    frame.fill_triangle({ 0, 0, 5, 1 }, { 10, 0, 5, 1 }, { 10, 10, 5, 1 }, green);
+    frame.fill_triangle({ 0, 0, 5, 1 }, { 10, 10, 5, 1 }, { 0, 10, 5, 1 }, green);
+    frame.fill_triangle({ 0, 0, 10, 1 }, { 10, 0, 0, 1 }, { 0, 10, 10, 1 }, red);
+    mu_assert(frame.drawn());
+
+    mu_assert(frame.color(1, 1) == green);
+    mu_assert(frame.color(8, 0) == red);
+    mu_assert(frame.color(9, 9) == green);
+    mu_assert(frame.depth(9, 9) == (FrameBuffer::farthest_depth - FrameBuffer::nearest_depth) / 2);
+
+    // Pixels not covered are left transparent.
+    FrameBuffer triangle(10, 10);
+    triangle.fill_triangle({ 0, 0, 0, 1 }, { 5, 0, 0, 1 }, { 0, 5, 0, 1 }, red);
+    mu_assert(triangle.color(1, 1) == red);
+    mu_assert(triangle.color(8, 8) == 0);
+
+    // Frame whose left-top pixel is at (20, 30) on the screen
+    FrameBuffer offset(10, 10, 20, 30);
+    offset.fill_triangle({ 20, 30, 0, 1 }, { 25, 30, 0, 1 }, { 20, 35, 0, 1 }, red);
+    mu_assert(offset.color(1, 1) == red);
+    mu_assert(offset.color(8, 8) == 0);
+
+    // Lines are drawn only where no surface is in front of them, and cut to the frame.
+    frame.draw_line({ -5, 8.5, 0, 1 }, { 15, 8.5, 10, 1 }, red);
+    mu_assert(frame.color(0, 8) == red);
+    mu_assert(frame.color(9, 8) == green);
+
+    return nullptr;
+}
+
+// Canvas ignoring everything drawn
+class NoScreen: public Canvas<VC>
+{
+public:
+
+    void move(const VC UNUSED &destination) override {}
+    void draw_line(const VC UNUSED &destination) override {}
+    void draw_circle(const VC UNUSED &center, const double UNUSED radius) override {}
+    void set_color(const Color UNUSED &color) override {}
+
+};
+
+static const char * fused_projection()
+{
+    shared_ptr<Window<Coord3D>> window = make_shared<Window<Coord3D>>(Coord3D(10, 20, -50), 40, 40);
+    window->rotate_z(30, window->center());
+
+    NoScreen screen;
+    ViewportCanvas<Coord3D> viewport(200, 200, window, screen);
+    window->set_viewport(viewport);
+
+    const Coord3D coord(15, 12, 7);
+
+    // Parallel projection drops z.
+    ParallelProjection<ViewportCanvas<Coord3D>> parallel(viewport, *window);
+    const PPC expected = window->world_to_window(Coord2D(coord.x(), coord.y()));
+    mu_assert(parallel.to_window(coord) == expected);
+    mu_assert(parallel.to_viewport(parallel.to_window(coord)) == window->world_to_viewport(Coord2D(coord.x(), coord.y())));
+
+    // Perspective projection leaves the plane of the window as is, and scales by the distance to the eye elsewhere.
+    PerspectiveProjection<ViewportCanvas<Coord3D>> perspective(viewport, *window);
+    const double d = window->projection_distance(), z = window->center().z();
+    const Coord3D on_window(15, 12, z), behind_window(15, 12, z + d);
+    mu_assert(perspective.to_window(on_window) == window->world_to_window(Coord2D(15, 12)));
+
+    const Coord2D scaled(window->center().x() + (15 - window->center().x()) / 2,
+                         window->center().y() + (12 - window->center().y()) / 2);
+    mu_assert(perspective.to_window(behind_window) == window->world_to_window(scaled));
+
+    // Only parallel projection is affine, taking coords to clip space scaled to pixels.
+    const TMatrix *map = parallel.pixel_map();
+    mu_assert(map != nullptr && perspective.pixel_map() == nullptr);
+
+    const TVector pixels = TVector(coord) * *map;
+    mu_assert(equals(pixels[0], parallel.to_clip(coord).x * viewport.content_width() / PPC::norm_width));
+    mu_assert(equals(pixels[1], parallel.to_clip(coord).y * viewport.content_height() / PPC::norm_height));
+
+    // Not known for a viewport without content, whose pixels could not be mapped back to clip space.
+    ViewportCanvas<Coord3D> empty(0, 0, window, screen);
+    ParallelProjection<ViewportCanvas<Coord3D>> flat(empty, *window);
+    mu_assert(flat.pixel_map() == nullptr);
+
+    return nullptr;
+}
+
+// Screen keeping the first position moved to and counting lines
+class FirstMove: public NoScreen
+{
+public:
+
+    void move(const VC &destination) override
+    {
+        if (!moved) first = destination;
+        moved = true;
+    }
+
+    void draw_line(const VC UNUSED &destination) override
+    {
+        lines++;
+    }
+
+    VC first = VC(0, 0);
+    bool moved = false;
+    size_t lines = 0;
+
+};
+
+static const char * projected_controls()
+{
+    shared_ptr<Window<Coord3D>> window = make_shared<Window<Coord3D>>(Coord3D(10, 20, -50), 40, 40);
+
+    FirstMove screen;
+    ViewportCanvas<Coord3D> viewport(200, 200, window, screen);
+    window->set_viewport(viewport);
+
+    vector<Coord3D> controls;
+    for (size_t i = 0; i < 4; i++)
+        for (size_t j = 0; j < 4; j++)
+            controls.push_back(Coord3D(5.0 * i, 5.0 * j + 10, (i + j) % 2 * 5.0));
+
+    Restore<SurfaceMethod> restore(surface_method);
+    surface_method = SurfaceMethod::ADAPTIVE;
+
+    // Drawn from the projected controls, starting at the projection of the first corner of the patch
+    BezierSurface surface({ controls });
+    ParallelProjection<ViewportCanvas<Coord3D>> parallel(viewport, *window);
+    surface.draw(parallel);
+
+    mu_assert(screen.lines > 0);
+    mu_assert(screen.first == parallel.to_viewport(parallel.to_window(controls[0])));
+
+    return nullptr;
+}
+
+static const char * group_levels()
+{
+    vector<MeshDecimator::Position> positions;
+    vector<MeshDecimator::Face> faces;
+    grid(32, positions, faces);
+
+    vector<shared_ptr<Coord3D>> vertices;
+    for (auto &p: positions) vertices.push_back(make_shared<Coord3D>(p[0], p[1], p[2]));
+
+    vector<shared_ptr<Face3D>> face_objects;
+    for (auto &f: faces)
+    {
+        list<shared_ptr<Coord3D>> face;
+        for (size_t v: f) face.push_back(vertices[v]);
+        face_objects.push_back(make_shared<Face3D>(face));
+    }
+
+    Group3D group(vertices, face_objects);
+
+    // Far enough for the group to cover a few pixels
+    shared_ptr<Window<Coord3D>> window = make_shared<Window<Coord3D>>(Coord3D(16, 16, -50), 4000, 4000);
+    NoScreen screen;
+    ViewportCanvas<Coord3D> viewport(200, 200, window, screen);
+    window->set_viewport(viewport);
+    ParallelProjection<ViewportCanvas<Coord3D>> parallel(viewport, *window);
+
+    Restore<DetailMethod> restore_detail(detail_method);
+    Restore<HiddenLineMethod> restore_hidden_lines(hidden_line_method);
+    detail_method = DetailMethod::AUTOMATIC;
+    hidden_line_method = HiddenLineMethod::NONE;
+
+    // The full mesh is drawn until the levels are built, which then changes the version of the group.
+    mu_assert(group.level_of_detail(parallel) == 0);
+
+    // The same levels, built here meanwhile, so that the background ones are about ready once these are
+    const vector<vector<MeshDecimator::Face>> levels = decimated_levels(positions, faces, LevelsOfDetail::minimum_faces);
+
+    const unsigned long version = group.version();
+    for (size_t wait = 0; wait < 200 && group.version() == version; wait++)
+    {
+        this_thread::sleep_for(chrono::milliseconds(1));
+        group.update();
+    }
+
+    mu_assert(group.version() != version);
+    const size_t level = group.level_of_detail(parallel);
+    mu_assert(level > 0 && level <= levels.size());
+
+    // Only the faces of the level are drawn, all of them, as the whole group is in the window.
+    size_t lines = 0;
+    for (auto &face: levels[level - 1]) lines += face.size();
+    mu_assert(lines < 4 * faces.size());
+
+    group.draw(parallel);
+    viewport.set_color(BLACK);
+    const SegmentCounters &counters = viewport.counters();
+    mu_assert(counters.drawn + counters.merged + counters.dropped == lines);
+
+    return nullptr;
+}
+
+// Screen adding up the lengths of the lines drawn
+class LineLengths: public NoScreen
+{
+public:
+
+    void move(const VC &destination) override
+    {
+        at = destination;
+    }
+
+    void draw_line(const VC &destination) override
+    {
+        length += hypot(destination.x() - at.x(), destination.y() - at.y());
+        at = destination;
+    }
+
+    VC at = VC(0, 0);
+    double length = 0;
+
+};
+
+// Group with a single square face of side size at depth z
+static shared_ptr<Group3D> square(double left, double bottom, double size, double z)
+{
+    vector<shared_ptr<Coord3D>> vertices = { make_shared<Coord3D>(left, bottom, z),
+                                             make_shared<Coord3D>(left + size, bottom, z),
+                                             make_shared<Coord3D>(left + size, bottom + size, z),
+                                             make_shared<Coord3D>(left, bottom + size, z) };
+
+    list<shared_ptr<Coord3D>> face(vertices.begin(), vertices.end());
+    return make_shared<Group3D>(vertices, vector<shared_ptr<Face3D>>{ make_shared<Face3D>(face) });
+}
+
+static const char * shared_depth_buffer()
+{
+    shared_ptr<Window<Coord3D>> window = make_shared<Window<Coord3D>>(Coord3D(15, 5, -50), 40, 40);
+
+    LineLengths screen;
+    ViewportCanvas<Coord3D> viewport(200, 200, window, screen);
+    window->set_viewport(viewport);
+    ParallelProjection<ViewportCanvas<Coord3D>> parallel(viewport, *window);
+
+    // A square behind, drawn first, with a quarter hidden by a square in front of it
+    shared_ptr<Group3D> back = square(0, 0, 20, 10), front = square(10, -10, 20, 0);
+    DisplayFile<Coord3D> display_file({ make_shared<Draw3DCommand>(back), make_shared<Draw3DCommand>(front) });
+
+    Restore<HiddenLineMethod> restore(hidden_line_method);
+    hidden_line_method = HiddenLineMethod::DEPTH_BUFFER;
+
+    parallel.start_depth_buffer(display_file);
+    mu_assert(parallel.screen_recorder() == nullptr);
+
+    back->draw(parallel);
+    const double pixels_per_unit = viewport.content_width() / 40;
+    mu_assert(abs(screen.length - 60 * pixels_per_unit) < 5 * pixels_per_unit);
+
+    front->draw(parallel);
+    mu_assert(abs(screen.length - 140 * pixels_per_unit) < 5 * pixels_per_unit);
+
+    return nullptr;
+}
+
+static const char * solid_near_plane()
+{
+    shared_ptr<Window<Coord3D>> window = make_shared<Window<Coord3D>>(Coord3D(15, 5, -50), 40, 40);
+
+    NoScreen screen;
+    ViewportCanvas<Coord3D> viewport(200, 200, window, screen);
+    window->set_viewport(viewport);
+    PerspectiveProjection<ViewportCanvas<Coord3D>> perspective(viewport, *window);
+
+    // Floor reaching from behind the eye, at z = -100, to beyond the window
+    vector<shared_ptr<Coord3D>> vertices = { make_shared<Coord3D>(0, 0, -200), make_shared<Coord3D>(30, 0, -200),
+                                             make_shared<Coord3D>(30, 0, 0), make_shared<Coord3D>(0, 0, 0) };
+    list<shared_ptr<Coord3D>> face(vertices.begin(), vertices.end());
+    shared_ptr<Group3D> floor = make_shared<Group3D>(vertices, vector<shared_ptr<Face3D>>{ make_shared<Face3D>(face) });
+
+    DisplayFile<Coord3D> display_file({ make_shared<Draw3DCommand>(floor) });
+
+    Restore<FillMethod> restore(fill_method);
+    fill_method = FillMethod::SOLID;
+
+    // The frame covers the content of the viewport, inside its margins.
+    perspective.start_frame(display_file);
+    const FrameBuffer &frame = *perspective.frame_buffer();
+    mu_assert(frame.left() == long(ceil(viewport.left())) && frame.width() <= long(viewport.content_width()));
+
+    // The part of the floor in front of the eye is filled, rather than the whole face being dropped.
+    floor->draw(perspective);
+    mu_assert(frame.drawn());
+    mu_assert(frame.color(frame.width() / 2, frame.height() - 1) != 0);
+
+    return nullptr;
+}
+
+// Screen keeping the frames painted on it
+class FrameScreen: public NoScreen, public FrameCanvas
+{
+public:
+
+    void draw_frame(const FrameBuffer &frame) override { frames.push_back(frame.picture()); }
+
+    vector<FrameBuffer> frames;
+
+};
+
+static const char * solid_window()
+{
+    // Window far from the axes, over an empty world, so that only the window itself is drawn
+    shared_ptr<Window<Coord3D>> window = make_shared<Window<Coord3D>>(Coord3D(50000, 50000, -50), 40, 40);
+    World<Coord3D> world(window, DisplayFile<Coord3D>({}));
+    Selection<Coord3D> selection(world);
+
+    FrameScreen screen;
+    ViewportCanvas<Coord3D> viewport(200, 200, window, screen);
+
+    Restore<FillMethod> restore(fill_method);
+    fill_method = FillMethod::SOLID;
+    viewport.render(world.display_file(), selection);
+
+    // The lines of the window are drawn into the frame, which is handed over once they are.
+    mu_assert(screen.frames.size() == 1 && screen.frames[0].drawn());
+
+    return nullptr;
+}
+
+static const char * homogeneous_clipping()
+{
+    // Inside, so accepted as is
+    ClipPoint a = { 0, 0, 1 }, b = { 0.5, 0.5, 1 };
+    mu_assert(outcode(a) == 0 && outcode(b) == 0);
+    mu_assert(clip_segment(a, b, outcode(a), outcode(b), CLIP_ALL));
+    mu_assert(b.x == 0.5 && b.y == 0.5);
+
+    // Both to the right, so rejected without clipping
+    ClipPoint c = { 2, 0, 1 }, d = { 3, 2, 1 };
+    mu_assert(outcode(c) == CLIP_RIGHT && outcode(d) == (CLIP_RIGHT | CLIP_TOP));
+    mu_assert(!clip_segment(c, d, outcode(c), outcode(d), CLIP_ALL));
+
+    // Crossing the right side
+    ClipPoint e = { 0, 0, 1 }, f = { 4, 0, 1 };
+    mu_assert(clip_segment(e, f, outcode(e), outcode(f), CLIP_ALL));
+    mu_assert(equals(f.x / f.w, 1));
+
+    // Going behind the eye, where w is negative: cut at the near plane, before the divide would mirror it
+    ClipPoint g = { 0.5, 0, 1 }, h = { 0.5, 0, -1 };
+    mu_assert((outcode(h) & CLIP_NEAR) != 0);
+    mu_assert(clip_segment(g, h, outcode(g), outcode(h), CLIP_NEAR));
+    mu_assert(equals(h.w, near_w) && h.w > 0);
+
+    return nullptr;
+}
+
+static const char * batch_clipping()
+{
+    // Seven segments, so the last group of lanes is only partly filled
+    const ClipPoint segments[][2] = {
+        { { 0, 0, 1 }, { 0.5, 0.5, 1 } },
+        { { 2, 0, 1 }, { 3, 2, 1 } },
+        { { 0, 0, 1 }, { 4, 0, 1 } },
+        { { 0.5, 0, 1 }, { 0.5, 0, -1 } },
+        { { -3, -3, 1 }, { 3, 3, 1 } },
+        { { 0, 2, 1 }, { 0.5, -0.5, 2 } },
+        { { 0, 0, -1 }, { 0, 0, -2 } }
+    };
+
+    SegmentBatch batch, clipped;
+    for (auto &segment: segments) batch.add(segment[0], segment[1]);
+    batch.clip(CLIP_ALL, clipped);
+
+    // Same segments left, in the same order, as when clipped one by one
+    size_t left = 0;
+    for (auto &segment: segments)
+    {
+        ClipPoint a = segment[0], b = segment[1];
+        if (!clip_segment(a, b, outcode(a), outcode(b), CLIP_ALL)) continue;
+
+        mu_assert(left < clipped.size());
+        const ClipPoint ca = clipped.a(left), cb = clipped.b(left);
+        mu_assert(equals(ca.x, a.x) && equals(ca.y, a.y) && equals(ca.w, a.w));
+        mu_assert(equals(cb.x, b.x) && equals(cb.y, b.y) && equals(cb.w, b.w));
+        left++;
+    }
+    mu_assert(left == clipped.size() && left == 5);
+
+    return nullptr;
+}
+
+static const char * guard_band_clipping()
+{
+    // Out of the window, but in a band four times its size
+    const ClipPoint a = { 3, 0, 1 };
+    mu_assert(outcode(a) == CLIP_RIGHT && outcode(a, 4) == 0);
+
+    // Leaving the band: clipped to the band rather than to the window
+    ClipPoint b = { 0, 0, 1 }, c = { 10, 0, 1 };
+    mu_assert(clip_segment(b, c, outcode(b, 4), outcode(c, 4), CLIP_ALL, 4));
+    mu_assert(equals(c.x / c.w, 4));
+
+    SegmentBatch batch, clipped;
+    batch.add({ 0, 0, 1 }, { 10, 0, 1 });
+    batch.clip(CLIP_ALL, clipped, 4);
+    mu_assert(clipped.size() == 1 && equals(clipped.b(0).x, 4));
+
+    return nullptr;
+}
+
+static const char * surface_tessellation()
+{
+    vector<Coord3D> controls;
+    for (size_t i = 0; i < surface_geometry_matrix_size; i++) controls.push_back(Coord3D(i % 4, i / 4, i % 3));
+
+    SplineSurface surface({ controls });
+
+    // Same chains as the vertices, built once until the surface changes
+    const Tessellation<Coord3D> *cached = surface.tessellation(0);
+    Tessellation<Coord3D> expected;
+    expected.assign(surface.vertices());
+    mu_assert(cached->vertices == expected.vertices && cached->ends == expected.ends);
+    mu_assert(cached->ends.size() > 1 && cached->ends.back() == cached->vertices.size());
+
+    const Coord3D first = cached->vertices.front();
+    mu_assert(surface.tessellation(0) == cached && cached->vertices.front() == first);
+
+    surface.transform(translation(1, 0, 0));
+    mu_assert(cached->vertices.front() == first);
+    mu_assert(surface.tessellation(0)->vertices.front() == first * translation(1, 0, 0));
+
+    Restore<SurfaceMethod> restore(surface_method);
+    surface_method = SurfaceMethod::REGULAR;
+    expected.assign(surface.vertices());
+    mu_assert(surface.tessellation(0)->vertices == expected.vertices);
+
+    return nullptr;
+}
+
+// Chains of tessellation
+static vector<vector<Coord3D>> chains(const Tessellation<Coord3D> &tessellation)
+{
+    vector<vector<Coord3D>> result;
+
+    size_t first = 0;
+    for (auto end: tessellation.ends)
+    {
+        result.push_back(vector<Coord3D>(tessellation.vertices.begin() + long(first), tessellation.vertices.begin() + long(end)));
+        first = end;
+    }
+
+    return result;
+}
+
+static const char * adaptive_surface()
+{
+    // Two patches of a spline surface sharing three rows of controls, and so the curve between them
+    vector<Coord3D> grid;
+    for (size_t i = 0; i < 5; i++)
+        for (size_t j = 0; j < 4; j++)
+            grid.push_back(Coord3D(10.0 * i, 10.0 * j, (i * j) % 3 * 5.0));
+
+    const vector<Coord3D> first(grid.begin(), grid.begin() + 16), second(grid.begin() + 4, grid.end());
+
+    Restore<SurfaceMethod> restore(surface_method);
+    surface_method = SurfaceMethod::ADAPTIVE;
+
+    SplineSurface surface({ first, second });
+    const size_t near = surface.tessellation(0.05)->vertices.size(), far = surface.tessellation(2)->vertices.size();
+    mu_assert(far < near);
+
+    // The shared side is drawn with the same vertices by both patches, leaving no cracks.
+    const vector<vector<Coord3D>> all = chains(*surface.tessellation(0.05));
+    bool shared = false;
+    for (size_t a = 0; a < all.size(); a++)
+        for (size_t b = a + 1; b < all.size(); b++)
+            shared = shared || all[a] == all[b];
+    mu_assert(shared);
+
+    return nullptr;
+}
+
+static const char * parallel_patches()
+{
+    // Patches of a spline surface along a strip of controls
+    vector<Coord3D> grid;
+    for (size_t i = 0; i < 15; i++)
+        for (size_t j = 0; j < 4; j++)
+            grid.push_back(Coord3D(10.0 * i, 10.0 * j, (i * j) % 3 * 5.0));
+
+    vector<vector<Coord3D>> patches;
+    for (size_t i = 0; i + 16 <= grid.size(); i += 4)
+        patches.push_back(vector<Coord3D>(grid.begin() + i, grid.begin() + i + 16));
+
+    auto generate = [&patches](size_t patch, vector<Coord3D> &vertices, vector<size_t> &ends)
+    {
+        generate_adaptive_surface_vertices(vertices, ends, spline, patches[patch], 0.1, 2.0);
+    };
+
+    // Same chains, in the order of the patches, whatever the number of threads
+    Tessellation<Coord3D> serial, parallel;
+    generate_patches(serial.vertices, serial.ends, patches.size(), generate, 1);
+    generate_patches(parallel.vertices, parallel.ends, patches.size(), generate, 3);
+
+    mu_assert(serial.ends == parallel.ends && serial.ends.back() == serial.vertices.size());
+    mu_assert(serial.vertices == parallel.vertices);
+
+    // Patches of objects recorded in parallel are tessellated by the pool of threads as well.
+    vector<Tessellation<Coord3D>> nested(4);
+    parallel_for(nested.size(), 3, [&nested, &patches, &generate](size_t item, size_t)
+    {
+        generate_patches(nested[item].vertices, nested[item].ends, patches.size(), generate, 3);
+    });
+
+    for (auto &tessellation: nested)
+        mu_assert(tessellation.ends == serial.ends && tessellation.vertices == serial.vertices);
+
+    return nullptr;
+}
+
 void all_tests()
 {
     mu_test(at_index);
@@ -97,6 +866,27 @@ void all_tests()
     mu_test(pow);
     mu_test(equidistant);
     mu_test(delta);
+    mu_test(forward_differences);
+    mu_test(basis_tables);
     mu_test(transformations);
+    mu_test(bounding_box);
+    mu_test(bvh);
+    mu_test(decimation);
+    mu_test(levels_of_detail);
+    mu_test(face_normal);
+    mu_test(depth_buffer);
+    mu_test(frame_buffer);
+    mu_test(fused_projection);
+    mu_test(projected_controls);
+    mu_test(group_levels);
+    mu_test(shared_depth_buffer);
+    mu_test(solid_near_plane);
+    mu_test(solid_window);
+    mu_test(homogeneous_clipping);
+    mu_test(batch_clipping);
+    mu_test(guard_band_clipping);
+    mu_test(surface_tessellation);
+    mu_test(adaptive_surface);
+    mu_test(parallel_patches);
 }
 
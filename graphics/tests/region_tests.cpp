@@ -2,6 +2,10 @@
 #include "../region.h"
 #include "../graphics2d.h"
 
+#include <bitset>
+#include <map>
+#include <random>
+
 static const char * test_region()
 {
     Coord2D north(0, +1.5);
@@ -25,7 +29,103 @@ static const char * test_region()
     return nullptr;
 }
 
+static const char * test_region_code()
+{
+    static_assert(region_code(0, 0) == 0, "Center must have no bits set");
+    static_assert(region_code(+1.5, +1.5) == (NORTH | EAST), "Northeast must be north and east");
+    static_assert(region(region_code(-1.5, -1.5)) == Region::SOUTHWEST, "Southwest must map to its region");
+
+    const PPC north(0, +1.5), northeast(+1.5, +1.5), south(0, -1.5), center(0, 0);
+
+    mu_assert(in_super_region(NORTH, north, northeast));
+    mu_assert(!in_super_region(EAST, north, northeast));
+    mu_assert(in_one_super_region(north, northeast));
+    mu_assert(!in_one_super_region(north, south));
+    mu_assert(choose_in_bounds(north, center) == center);
+
+    return nullptr;
+}
+
+// Region lookup as it was before outcodes: a bitset built from a string, matched against a map of strings.
+static map<string, Region> legacy_region_mapping
+    {
+        { "1000", Region::NORTH }, { "1010", Region::NORTHEAST }, { "0010", Region::EAST },
+        { "0110", Region::SOUTHEAST }, { "0100", Region::SOUTH }, { "0101", Region::SOUTHWEST },
+        { "0001", Region::WEST }, { "1001", Region::NORTHWEST }, { "0000", Region::CENTRAL },
+    };
+
+typedef bitset<REGION_CODE_SIZE> LegacyRegionCode;
+
+static LegacyRegionCode legacy_region_code(const TVector &v)
+{
+    const double x = v[0], y = v[1];
+
+    LegacyRegionCode code { "0000" };
+
+    if (x < -1) code.set(0); else if (x > +1) code.set(1);
+    if (y < -1) code.set(2); else if (y > +1) code.set(3);
+
+    return code;
+}
+
+static Region legacy_region(const TVector &v)
+{
+    const LegacyRegionCode code = legacy_region_code(v);
+
+    for (auto &item: legacy_region_mapping)
+        if (code == LegacyRegionCode { item.first })
+            return item.second;
+
+    return Region::CENTRAL;
+}
+
+static bool legacy_in_one_super_region(const TVector &a, const TVector &b)
+{
+    return (legacy_region_code(a) & legacy_region_code(b)).any();
+}
+
+// Cost per segment of the region tests done by visibility(), before and after outcodes
+static const char * region_cost()
+{
+    constexpr size_t count = 100000;
+
+    mt19937 random(42);
+    uniform_real_distribution<double> coordinate(-3, 3);
+
+    vector<PPC> ends;
+    for (size_t i = 0; i < 2 * count; i++) ends.emplace_back(coordinate(random), coordinate(random));
+
+    size_t legacy_outside = 0, outside = 0;
+
+    clock_t start = clock();
+    for (size_t i = 0; i < count; i++)
+    {
+        const PPC &a = ends[2 * i], &b = ends[2 * i + 1];
+        if (legacy_in_one_super_region(a, b) || legacy_region(a) != legacy_region(b)) legacy_outside++;
+    }
+    const double legacy_time = elapsed_secs(start);
+
+    start = clock();
+    for (size_t i = 0; i < count; i++)
+    {
+        const PPC &a = ends[2 * i], &b = ends[2 * i + 1];
+        if (in_one_super_region(a, b) || region(a) != region(b)) outside++;
+    }
+    const double time = elapsed_secs(start);
+
+    printf("region_cost: %.1lf ns per segment with strings, %.1lf ns with outcodes\n",
+           legacy_time * 1e9 / count, time * 1e9 / count);
+
+    mu_assert(outside == legacy_outside);
+
+    for (auto &end: ends) mu_assert(region(end) == legacy_region(end));
+
+    return nullptr;
+}
+
 void all_tests()
 {
     mu_test(test_region);
+    mu_test(test_region_code);
+    mu_test(region_cost);
 }
@@ -1,8 +1,13 @@
 #pragma once
 
 #include "display.h"
+#include "parallel.h"
 #include "timer.h"
 
+#include <cmath>
+#include <cstdint>
+#include <unordered_set>
+
 // Render a cross at center with radius, using color.
 inline void render_cross(Canvas<Coord2D> &canvas, const Coord2D &center, double radius, const Color &h_color, const Color &v_color)
 {
@@ -186,6 +191,16 @@ public:
         }
     }
 
+    // Multiply by factor the number of steps the selected curves and surfaces are drawn in.
+    void scale_steps(double factor)
+    {
+        for (auto &object: _selected_group.objects())
+        {
+            auto tessellated = dynamic_pointer_cast<Tessellated>(object);
+            if (tessellated != nullptr) tessellated->set_steps(size_t(round(tessellated->steps() * factor)));
+        }
+    }
+
     // Select the axis to be transformed.
     void select_transform_axis(TransformAxis axis)
     {
@@ -238,46 +253,82 @@ private:
 
 };
 
+// Segments that reached the viewport in a frame
+struct SegmentCounters
+{
+    // Segments sent to the screen, including those standing for merged runs
+    size_t drawn = 0;
+
+    // Sub-pixel segments folded into a segment sent to the screen
+    size_t merged = 0;
+
+    // Sub-pixel segments not sent at all, as the pixel they cover was already drawn
+    size_t dropped = 0;
+};
+
 // Area on a screen to execute display commands
 template<class Coord>
-class ViewportCanvas: public Canvas<Coord2D>, public Viewport, public ClippingArea
+class ViewportCanvas final: public Canvas<Coord2D>, public Viewport, public ClippingArea, public ScreenRecorder
 {
 public:
 
     using Window = ::Window<Coord>;
 
+    // Segments shorter than this, in pixels, are merged with the segments following them.
+    constexpr static double subpixel_length = 1;
+
     ViewportCanvas(double width, double height, shared_ptr<Window> window, Canvas<VC> &canvas)
-        : Viewport(width, height), _window(window), _canvas(canvas) {}
+        : Viewport(width, height), _window(window), _canvas(canvas), _output(&canvas),
+          _run_start(0, 0), _current(0, 0), _run_far(0, 0) {}
 
     // Render DisplayFile, the center, the x axis and y axis on canvas.
     void render(DisplayFile<Coord> &display_file, Selection<Coord> &selection)
     {
         _window->set_viewport(*this);
+        _counters = SegmentCounters();
+        _dots.clear();
 
 #ifdef WORLD_2D
         Canvas<Coord2D> *projection_canvas = this;
 #endif
 
 #ifdef WORLD_3D
-        shared_ptr<ProjectionCanvas<Coord3D>> projection_canvas;
-        if (projection_method == ProjectionMethod::ORTHOGONAL)
+        if (projection_method == ProjectionMethod::PERSPECTIVE)
         {
-            projection_canvas = make_shared<ParallelProjection>(*this);
+            printf("projection created\n");
         }
-        else
+
+        shared_ptr<ProjectionCanvas<Coord3D>> projection_canvas = projection(*this);
+#endif
+
+#ifdef WORLD_3D
+        if (fill_method == FillMethod::SOLID)
         {
-            printf("projection created\n");
-            projection_canvas = make_shared<PerspectiveProjection>(*this, *_window);
+            projection_canvas->start_frame(display_file);
+        }
+        else if (hidden_line_method == HiddenLineMethod::DEPTH_BUFFER)
+        {
+            projection_canvas->start_depth_buffer(display_file);
         }
 #endif
 
+        // Drawn once the frame is started, so that the surfaces in front of the axes hide them
         render_axis(*projection_canvas);
 
         printf("Render display file: started\n");
         const clock_t start = clock();
+
+        if (projection_canvas->screen_recorder() != nullptr)
+        {
+            record_in_parallel(display_file, thread_count());
+        }
+
         display_file.render(*projection_canvas, selection);
+
         const double time = elapsed_secs(start);
         printf("Render display file: finished (t = %9.6lf)\n", time);
+        printf("Render display file: segments drawn = %lu, merged = %lu, dropped = %lu\n",
+            _counters.drawn, _counters.merged, _counters.dropped);
 
 #ifdef WORLD_2D
         selection.render_controls(*projection_canvas);
@@ -286,6 +337,73 @@ public:
         selection.render_center(*projection_canvas);
 
         _window->draw(*projection_canvas);
+
+#ifdef WORLD_3D
+        // Handed over once everything is drawn, as the center and the window are drawn into the frame when solid
+        FrameBuffer *frame_buffer = projection_canvas->frame_buffer();
+        FrameCanvas *frame_canvas = dynamic_cast<FrameCanvas *>(&_canvas);
+
+        if (frame_buffer != nullptr && frame_buffer->drawn() && frame_canvas != nullptr)
+        {
+            flush_run();
+            frame_canvas->draw_frame(*frame_buffer);
+        }
+#endif
+
+        flush_run();
+    }
+
+    // Segments that reached the viewport since the frame started
+    const SegmentCounters & counters() const
+    {
+        return _counters;
+    }
+
+    // Record the screen-space output of the stale commands in display file on threads, each one drawing through
+    // its own canvases, so that rendering the display file afterwards only replays recordings in order.
+    void record_in_parallel(DisplayFile<Coord> &display_file, size_t threads)
+    {
+        vector<ScreenCachedCommand<Coord> *> stale;
+
+        for (auto &command: display_file.commands())
+        {
+            ScreenCachedCommand<Coord> *cached = dynamic_cast<ScreenCachedCommand<Coord> *>(command.get());
+
+            if (cached != nullptr && !cached->recorded(*this))
+            {
+                stale.push_back(cached);
+            }
+        }
+
+        threads = min(threads, stale.size());
+        if (threads < 2) return;
+
+        NullCanvas screen;
+        vector<shared_ptr<ViewportCanvas>> viewports;
+        vector<shared_ptr<::Canvas<Coord>>> canvases;
+
+        for (size_t thread = 0; thread < threads; thread++)
+        {
+            viewports.push_back(make_shared<ViewportCanvas>(width(), height(), _window, screen));
+#ifdef WORLD_2D
+            canvases.push_back(viewports.back());
+#endif
+#ifdef WORLD_3D
+            canvases.push_back(projection(*viewports.back()));
+#endif
+        }
+
+        parallel_for(stale.size(), threads, [&stale, &canvases](size_t command, size_t thread)
+        {
+            stale[command]->refresh(*canvases[thread]);
+        });
+
+        for (auto &viewport: viewports)
+        {
+            _counters.drawn += viewport->counters().drawn;
+            _counters.merged += viewport->counters().merged;
+            _counters.dropped += viewport->counters().dropped;
+        }
     }
 
     // True if area contains world coord.
@@ -306,34 +424,219 @@ public:
         return _window->window_to_world(coord);
     }
 
+    // World length covered by a pixel of the viewport
+    double pixel_size() const override
+    {
+        return max(_window->width() / content_width(), _window->height() / content_height());
+    }
+
     // Move to destination.
     void move(const Coord2D &destination) override
     {
-        _canvas.move(_window->world_to_viewport(destination));
+        move_in_viewport(_window->world_to_viewport(destination));
     }
 
     // Draw line from current position to destination.
     void draw_line(const Coord2D &destination) override
     {
-        _canvas.draw_line(_window->world_to_viewport(destination));
+        draw_line_in_viewport(_window->world_to_viewport(destination));
+    }
+
+    // Move to viewport_destination; a move to the current position keeps the run of sub-pixel segments going.
+    void move_in_viewport(const VC &viewport_destination)
+    {
+        if (viewport_destination == _current) return;
+
+        flush_run();
+        start_run(viewport_destination);
+    }
+
+    // Draw line from current position to viewport_destination.
+    // Sub-pixel segments are accumulated in a run, sent as a single segment once it spans a pixel.
+    void draw_line_in_viewport(const VC &viewport_destination)
+    {
+        if (squared_distance(_current, viewport_destination) >= subpixel_length * subpixel_length)
+        {
+            if (_run_segments > 0)
+            {
+                _run_segments--;
+                send(_run_start, _current);
+                start_run(_current);
+            }
+
+            send(_current, viewport_destination);
+            start_run(viewport_destination);
+            return;
+        }
+
+        const double run_distance = squared_distance(_run_start, viewport_destination);
+
+        if (run_distance >= subpixel_length * subpixel_length)
+        {
+            send(_run_start, viewport_destination);
+            start_run(viewport_destination);
+            return;
+        }
+
+        _run_segments++;
+        _current = viewport_destination;
+
+        if (run_distance > _run_far_distance)
+        {
+            _run_far = viewport_destination;
+            _run_far_distance = run_distance;
+        }
     }
 
     // Draw circle with the specified center, radius and color.
     void draw_circle(const Coord2D &center, const double radius) override
     {
-        _canvas.draw_circle(_window->world_to_viewport(center), radius);
+        draw_circle_in_viewport(_window->world_to_viewport(center), radius);
+    }
+
+    // Draw circle with the specified center in the viewport and radius.
+    void draw_circle_in_viewport(const VC &center, const double radius)
+    {
+        flush_run();
+        _output->draw_circle(center, radius);
     }
 
     // Set the color to be used when drawing.
     void set_color(const Color &color) override
     {
+        flush_run();
         _canvas.set_color(color);
     }
 
+    // Recorder of the viewport output
+    ScreenRecorder * screen_recorder() override
+    {
+        return this;
+    }
+
+    // Area of the world in the window
+    ClippingArea * clipping_area() override
+    {
+        return this;
+    }
+
+    // Pixels of the viewport
+    Viewport * viewport() override
+    {
+        return this;
+    }
+
+    // Version of the window, which changes whenever the window or the viewport change.
+    unsigned long camera_version() const override
+    {
+        return _window->version();
+    }
+
+    // Send the viewport output to recording, or back to the screen if recording is nullptr.
+    // Pixels covered by sub-pixel runs are tracked per recording, so that recordings stay independent.
+    void record(ScreenVertices *recording) override
+    {
+        flush_run();
+        _dots.clear();
+        _output = recording == nullptr ? &_canvas : recording;
+    }
+
+    // Send the recorded viewport output to the screen.
+    void replay(const ScreenVertices &recording) override
+    {
+        flush_run();
+        recording.replay(_canvas);
+    }
+
 private:
 
+    // Canvas drawing nothing, for viewports whose output is only recorded
+    class NullCanvas: public Canvas<VC>
+    {
+    public:
+
+        void move(const VC UNUSED &destination) override {}
+        void draw_line(const VC UNUSED &destination) override {}
+        void draw_circle(const VC UNUSED &center, const double UNUSED radius) override {}
+        void set_color(const Color UNUSED &color) override {}
+
+    };
+
+#ifdef WORLD_3D
+
+    // Projection of the world onto viewport according to the projection method
+    shared_ptr<ProjectionCanvas<Coord3D>> projection(ViewportCanvas &viewport) const
+    {
+        if (projection_method == ProjectionMethod::ORTHOGONAL)
+        {
+            return make_shared<ParallelProjection<ViewportCanvas>>(viewport, *_window);
+        }
+        else
+        {
+            return make_shared<PerspectiveProjection<ViewportCanvas>>(viewport, *_window);
+        }
+    }
+
+#endif
+
+    static double squared_distance(const VC &a, const VC &b)
+    {
+        const double dx = b.x() - a.x(), dy = b.y() - a.y();
+        return dx * dx + dy * dy;
+    }
+
+    // Send the segment from a to b to the output, folding the pending sub-pixel segments into it.
+    void send(const VC &a, const VC &b)
+    {
+        _output->move(a);
+        _output->draw_line(b);
+
+        _counters.drawn++;
+        _counters.merged += _run_segments;
+    }
+
+    // Start an empty run of sub-pixel segments at position.
+    void start_run(const VC &position)
+    {
+        _run_start = _current = _run_far = position;
+        _run_far_distance = 0;
+        _run_segments = 0;
+    }
+
+    // Send the pending run of sub-pixel segments as a single segment, unless its pixel was already drawn.
+    void flush_run()
+    {
+        if (_run_segments == 0) return;
+
+        const uint64_t pixel = uint64_t(uint32_t(int64_t(floor(_run_start.x())))) << 32 |
+                               uint32_t(int64_t(floor(_run_start.y())));
+
+        if (_run_far_distance == 0 || !_dots.insert(pixel).second)
+        {
+            _counters.dropped += _run_segments;
+        }
+        else
+        {
+            _run_segments--;
+            send(_run_start, _run_far);
+        }
+
+        start_run(_current);
+    }
+
     shared_ptr<Window> _window;
     Canvas<VC> &_canvas;
+    Canvas<VC> *_output;
+
+    // Run of sub-pixel segments not sent yet, and the point of the run farthest from its start
+    VC _run_start, _current, _run_far;
+    double _run_far_distance = 0;
+    size_t _run_segments = 0;
+
+    // Pixels already covered by sub-pixel runs
+    unordered_set<uint64_t> _dots;
+
+    SegmentCounters _counters;
 
 };
 
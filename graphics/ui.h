@@ -2,6 +2,8 @@
 
 #include "tools.h"
 
+#include <fstream>
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdocumentation-unknown-command"
 #pragma GCC diagnostic ignored "-Wdocumentation"
@@ -27,7 +29,7 @@ using UserViewport = ViewportCanvas<Coord3D>;
 #endif
 
 // Canvas for GTK surface
-class SurfaceCanvas: public Canvas<VC>
+class SurfaceCanvas: public Canvas<VC>, public FrameCanvas
 {
 public:
 
@@ -58,6 +60,13 @@ public:
             width - 2 * margin, height - 2 * margin);
         cairo_stroke_preserve(cr);
         cairo_fill(cr);
+
+        // Lines left in the guard band are clipped here, to the content of the viewport.
+        if (clipping_method == ClippingMethod::GUARD_BAND)
+        {
+            cairo_rectangle(cr, margin, margin, width - 2 * margin, height - 2 * margin);
+            cairo_clip(cr);
+        }
     }
 
     // Move to destination.
@@ -89,6 +98,23 @@ public:
         cairo_set_source_rgb(cr, color.red(), color.green(), color.blue());
     }
 
+    // Paint the pixels of frame over the surface, keeping the color used when drawing.
+    void draw_frame(const FrameBuffer &frame) override
+    {
+        const int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, int(frame.width()));
+        assert(stride == int(frame.width() * sizeof(uint32_t)));
+
+        cairo_surface_t *image = cairo_image_surface_create_for_data(
+            (unsigned char *) frame.pixels(), CAIRO_FORMAT_ARGB32, int(frame.width()), int(frame.height()), stride);
+
+        cairo_save(cr);
+        cairo_set_source_surface(cr, image, frame.left(), frame.top());
+        cairo_paint(cr);
+        cairo_restore(cr);
+
+        cairo_surface_destroy(image);
+    }
+
 private:
 
     cairo_t *cr;
@@ -106,7 +132,11 @@ static void refresh(GtkWidget *widget)
 
 static cairo_surface_t *surface = NULL;
 
-static gboolean refresh_surface(GtkWidget *widget, GdkEventConfigure UNUSED *event, gpointer data)
+// Output of the last rendered frame, and its size
+static DrawList frame;
+static int frame_width = 0, frame_height = 0;
+
+static gboolean refresh_surface(GtkWidget *widget, GdkEventConfigure *event, gpointer data)
 {
     if (surface) cairo_surface_destroy(surface);
 
@@ -120,15 +150,35 @@ static gboolean refresh_surface(GtkWidget *widget, GdkEventConfigure UNUSED *eve
     SurfaceCanvas canvas(surface);
     canvas.clear(widget_width, widget_height);
 
-    UserSelection &selection = *(UserSelection*)data;
-    UserViewport viewport(widget_width, widget_height, selection.window(), canvas);
-    viewport.render(selection.display_file(), selection);
+    // Configure events keeping the size, such as moving the window, replay the last frame.
+    if (event == nullptr || widget_width != frame_width || widget_height != frame_height)
+    {
+        frame.clear();
+
+        UserSelection &selection = *(UserSelection*)data;
+        UserViewport viewport(widget_width, widget_height, selection.window(), frame);
+        viewport.render(selection.display_file(), selection);
+
+        frame_width = widget_width;
+        frame_height = widget_height;
+    }
+
+    frame.replay(canvas);
 
     refresh(widget);
 
     return true;
 }
 
+// Write the last rendered frame to file as an SVG image.
+static void export_frame(const string &file_name)
+{
+    ofstream file(file_name);
+    frame.write_svg(file, Viewport(frame_width, frame_height));
+
+    printf("Export frame: %s (%lu operations)\n", file_name.c_str(), frame.size());
+}
+
 static void refresh_canvas(GtkWidget *canvas, UserSelection &selection)
 {
     refresh_surface(GTK_WIDGET(canvas), nullptr, &selection);